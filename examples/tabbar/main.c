@@ -7,6 +7,7 @@
 
 // Include the renderer header and custom components
 #include "renderer.h" // Includes krb.h, raylib.h, RenderElement, render_element()
+#include "event_dispatch.h"
 #include "custom_components.h"
 #include "custom_tabbar.h"
 
@@ -28,41 +29,20 @@ typedef enum {
 
 static ActiveTab current_tab = TAB_HOME;
 
-// --- Event Handling Logic ---
-void showHomePage() {
-    printf(">>> Switching to HOME tab <<<\n");
-    current_tab = TAB_HOME;
-}
-
-void showSearchPage() {
-    printf(">>> Switching to SEARCH tab <<<\n");
-    current_tab = TAB_SEARCH;
-}
-
-void showProfilePage() {
-    printf(">>> Switching to PROFILE tab <<<\n");
-    current_tab = TAB_PROFILE;
+// --- Tab Visibility Management ---
+// Page and tab element ids as atoms of the loaded document, indexed by ActiveTab
+static KrbAtom page_atoms[3];
+static KrbAtom tab_atoms[3];
+
+void resolve_tab_atoms(const KrbDocument* doc) {
+    page_atoms[TAB_HOME] = krb_find_atom(doc, "page_home");
+    page_atoms[TAB_SEARCH] = krb_find_atom(doc, "page_search");
+    page_atoms[TAB_PROFILE] = krb_find_atom(doc, "page_profile");
+    tab_atoms[TAB_HOME] = krb_find_atom(doc, "tab_home");
+    tab_atoms[TAB_SEARCH] = krb_find_atom(doc, "tab_search");
+    tab_atoms[TAB_PROFILE] = krb_find_atom(doc, "tab_profile");
 }
 
-typedef void (*KrbEventHandlerFunc)();
-typedef struct { const char* name; KrbEventHandlerFunc func; } EventHandlerMapping;
-
-EventHandlerMapping event_handlers[] = {
-    { "showHomePage", showHomePage },
-    { "showSearchPage", showSearchPage },
-    { "showProfilePage", showProfilePage },
-    { NULL, NULL }
-};
-
-KrbEventHandlerFunc find_handler(const char* name) {
-    if (!name) return NULL;
-    for (int i = 0; event_handlers[i].name != NULL; i++) {
-        if (strcmp(event_handlers[i].name, name) == 0) return event_handlers[i].func;
-    }
-    fprintf(stderr, "Warning: Handler function not found for name: %s\n", name);
-    return NULL;
-}
-// --- Tab Visibility Management ---
 void update_tab_visibility(RenderContext* ctx) {
     if (!ctx) return;
     
@@ -71,19 +51,16 @@ void update_tab_visibility(RenderContext* ctx) {
         RenderElement* el = &ctx->elements[i];
         if (!el || el->is_placeholder) continue;
         
-        // Get element ID string
-        const char* element_id = NULL;
-        if (el->header.id > 0 && el->header.id < ctx->doc->header.string_count && ctx->doc->strings[el->header.id]) {
-            element_id = ctx->doc->strings[el->header.id];
-        }
+        // Get element ID atom
+        KrbAtom element_id = el->cold->header.id > 0 ? krb_string_atom(ctx->doc, el->cold->header.id) : KRB_INVALID_ATOM;
         
-        if (element_id) {
+        if (element_id != KRB_INVALID_ATOM) {
             // Update visibility based on current tab
-            if (strcmp(element_id, "page_home") == 0) {
+            if (element_id == page_atoms[TAB_HOME]) {
                 el->is_visible = (current_tab == TAB_HOME);
-            } else if (strcmp(element_id, "page_search") == 0) {
+            } else if (element_id == page_atoms[TAB_SEARCH]) {
                 el->is_visible = (current_tab == TAB_SEARCH);
-            } else if (strcmp(element_id, "page_profile") == 0) {
+            } else if (element_id == page_atoms[TAB_PROFILE]) {
                 el->is_visible = (current_tab == TAB_PROFILE);
             }
         }
@@ -92,23 +69,20 @@ void update_tab_visibility(RenderContext* ctx) {
     // Update TabBar button styles to show active state
     for (int i = 0; i < ctx->element_count; i++) {
         RenderElement* el = &ctx->elements[i];
-        if (!el || el->is_placeholder || el->header.type != ELEM_TYPE_BUTTON) continue;
+        if (!el || el->is_placeholder || el->type != ELEM_TYPE_BUTTON) continue;
         
-        const char* element_id = NULL;
-        if (el->header.id > 0 && el->header.id < ctx->doc->header.string_count && ctx->doc->strings[el->header.id]) {
-            element_id = ctx->doc->strings[el->header.id];
-        }
+        KrbAtom element_id = el->cold->header.id > 0 ? krb_string_atom(ctx->doc, el->cold->header.id) : KRB_INVALID_ATOM;
         
-        if (element_id) {
+        if (element_id != KRB_INVALID_ATOM) {
             // Determine which style to use based on active tab
-            uint8_t new_style_id = 0;
+            uint16_t new_style_id = 0;
             bool is_active = false;
             
-            if (strcmp(element_id, "tab_home") == 0 && current_tab == TAB_HOME) {
+            if (element_id == tab_atoms[TAB_HOME] && current_tab == TAB_HOME) {
                 is_active = true;
-            } else if (strcmp(element_id, "tab_search") == 0 && current_tab == TAB_SEARCH) {
+            } else if (element_id == tab_atoms[TAB_SEARCH] && current_tab == TAB_SEARCH) {
                 is_active = true;
-            } else if (strcmp(element_id, "tab_profile") == 0 && current_tab == TAB_PROFILE) {
+            } else if (element_id == tab_atoms[TAB_PROFILE] && current_tab == TAB_PROFILE) {
                 is_active = true;
             }
             
@@ -120,8 +94,12 @@ void update_tab_visibility(RenderContext* ctx) {
             }
             
             // Update style ID and re-apply style if it changed
-            if (el->header.style_id != new_style_id) {
-                el->header.style_id = new_style_id;
+            if (el->cold->header.style_id != new_style_id) {
+                el->cold->header.style_id = new_style_id;
+
+                // Restyle the base paint (not the hovered/pressed paint on top of it)
+                uint8_t state = el->cold->current_state;
+                update_element_state(el, 0, ctx, NULL);
                 
                 // Re-apply the style properties
                 if (new_style_id > 0 && new_style_id <= ctx->doc->header.style_count && ctx->doc->styles) {
@@ -138,10 +116,40 @@ void update_tab_visibility(RenderContext* ctx) {
                         apply_property_to_element(el, &style->properties[j], ctx->doc, NULL);
                     }
                 }
+
+                // Rebuild the state deltas over the new base and show the state again
+                resolve_state_properties(el, ctx, NULL);
+                update_element_state(el, state, ctx, NULL);
             }
         }
     }
 }
+
+// --- Event Handling Logic ---
+// Callbacks get the render context as user data so they can apply the switch directly
+static void select_tab(RenderContext* ctx, ActiveTab tab) {
+    current_tab = tab;
+    update_tab_visibility(ctx);
+    mark_layout_dirty(ctx);
+}
+
+void showHomePage(RenderElement* element, uint8_t event_type, void* user_data) {
+    (void)element; (void)event_type;
+    printf(">>> Switching to HOME tab <<<\n");
+    select_tab((RenderContext*)user_data, TAB_HOME);
+}
+
+void showSearchPage(RenderElement* element, uint8_t event_type, void* user_data) {
+    (void)element; (void)event_type;
+    printf(">>> Switching to SEARCH tab <<<\n");
+    select_tab((RenderContext*)user_data, TAB_SEARCH);
+}
+
+void showProfilePage(RenderElement* element, uint8_t event_type, void* user_data) {
+    (void)element; (void)event_type;
+    printf(">>> Switching to PROFILE tab <<<\n");
+    select_tab((RenderContext*)user_data, TAB_PROFILE);
+}
 // --- Main Application ---
 int main(int argc, char* argv[]) {
     // --- Setup ---
@@ -159,29 +167,20 @@ int main(int argc, char* argv[]) {
 
     fprintf(debug_file, "INFO: Using embedded TabBar KRB data (Size: %u bytes)\n", krb_data_size);
 
-    // --- Create In-Memory Stream ---
-    FILE* file = fmemopen(krb_data_buffer, krb_data_size, "rb");
-    if (!file) {
-        perror("ERROR: Could not create in-memory stream with fmemopen");
-        if (debug_file != stderr) fclose(debug_file);
-        return 1;
-    }
-
-    // --- Parsing ---
+    // --- Parsing (Directly from the embedded buffer) ---
     KrbDocument doc = {0};
     fprintf(debug_file, "INFO: Reading TabBar KRB document from memory...\n");
-    if (!krb_read_document(file, &doc)) {
+    if (!krb_read_document_from_buffer(krb_data_buffer, krb_data_size, &doc)) {
         fprintf(stderr, "ERROR: Failed to parse embedded TabBar KRB data\n");
-        fclose(file);
         krb_free_document(&doc);
         if (debug_file != stderr) fclose(debug_file);
         return 1;
     }
-    fclose(file);
     
     fprintf(debug_file, "INFO: Parsed embedded TabBar KRB OK - Ver=%u.%u Elements=%u ComponentDefs=%u Styles=%u Strings=%u\n",
             doc.version_major, doc.version_minor, doc.header.element_count, 
             doc.header.component_def_count, doc.header.style_count, doc.header.string_count);
+    resolve_tab_atoms(&doc);
 
     if (doc.header.element_count == 0) {
         fprintf(stderr, "ERROR: No elements found in KRB data.\n");
@@ -208,26 +207,27 @@ int main(int argc, char* argv[]) {
 
     if ((doc.header.flags & FLAG_HAS_APP) && doc.header.element_count > 0 && doc.elements[0].type == ELEM_TYPE_APP) {
         app_element = &ctx->elements[0];
-        app_element->header = doc.elements[0];
+        set_element_header(app_element, &doc.elements[0]);
         app_element->original_index = 0;
-        app_element->text = NULL;
+        app_element->cold->text = NULL;
         app_element->parent = NULL;
         app_element->child_count = 0;
         app_element->is_placeholder = false;
-        app_element->is_component_instance = false;
-        app_element->component_instance = NULL;
-        app_element->custom_properties = NULL;
-        app_element->custom_prop_count = 0;
+        app_element->cold->is_component_instance = false;
+        app_element->cold->component_instance = NULL;
+        app_element->cold->custom_properties = NULL;
+        app_element->cold->custom_prop_count = 0;
         app_element->is_visible = true; // App is always visible
         
-        for(int k=0; k<MAX_ELEMENTS; ++k) app_element->children[k] = NULL;
+        app_element->children = NULL;
+        app_element->child_capacity = 0;
         app_element->is_interactive = false;
         
         fprintf(debug_file, "INFO: Processing App Element (Index 0)\n");
 
         // Apply App Style
-        if (app_element->header.style_id > 0 && app_element->header.style_id <= doc.header.style_count) {
-             int style_idx = app_element->header.style_id - 1;
+        if (app_element->cold->header.style_id > 0 && app_element->cold->header.style_id <= doc.header.style_count) {
+             int style_idx = app_element->cold->header.style_id - 1;
              if (doc.styles && style_idx >= 0) {
                 KrbStyle* app_style = &doc.styles[style_idx];
                 for(int j=0; j<app_style->property_count; ++j) {
@@ -243,19 +243,19 @@ int main(int argc, char* argv[]) {
 
         // Apply App direct properties
         if (doc.properties && doc.properties[0]) {
-            for (int j = 0; j < app_element->header.property_count; j++) {
+            for (int j = 0; j < app_element->cold->header.property_count; j++) {
                 KrbProperty* prop = &doc.properties[0][j]; 
                 if (!prop || !prop->value) continue;
                 
                 if (prop->property_id == PROP_ID_WINDOW_WIDTH && prop->value_type == VAL_TYPE_SHORT && prop->size == 2) { 
                     ctx->window_width = krb_read_u16_le(prop->value); 
-                    app_element->header.width = ctx->window_width; 
+                    app_element->width = ctx->window_width; 
                 } else if (prop->property_id == PROP_ID_WINDOW_HEIGHT && prop->value_type == VAL_TYPE_SHORT && prop->size == 2) { 
                     ctx->window_height = krb_read_u16_le(prop->value); 
-                    app_element->header.height = ctx->window_height; 
-                } else if (prop->property_id == PROP_ID_WINDOW_TITLE && prop->value_type == VAL_TYPE_STRING && prop->size == 1) { 
-                    uint8_t idx = *(uint8_t*)prop->value; 
-                    if (idx < doc.header.string_count && doc.strings[idx]) { 
+                    app_element->height = ctx->window_height; 
+                } else if (prop->property_id == PROP_ID_WINDOW_TITLE && prop->value_type == VAL_TYPE_STRING) { 
+                    uint16_t idx;
+                    if (krb_read_ref_value(prop->value, prop->size, &idx) && idx < doc.header.string_count && doc.strings[idx]) { 
                         free(ctx->window_title); 
                         ctx->window_title = strdup(doc.strings[idx]); 
                     } 
@@ -288,11 +288,11 @@ int main(int argc, char* argv[]) {
         if (app_element && i == 0) continue; // Skip App element
 
         RenderElement* current_render_el = &ctx->elements[i];
-        current_render_el->header = doc.elements[i];
+        set_element_header(current_render_el, &doc.elements[i]);
         current_render_el->original_index = i;
 
         // Init with defaults
-        current_render_el->text = NULL;
+        current_render_el->cold->text = NULL;
         current_render_el->bg_color = ctx->default_bg;
         current_render_el->fg_color = ctx->default_fg;
         current_render_el->border_color = ctx->default_border;
@@ -301,35 +301,36 @@ int main(int argc, char* argv[]) {
         current_render_el->parent = NULL;
         current_render_el->child_count = 0;
         current_render_el->is_placeholder = false;
-        current_render_el->is_component_instance = false;
-        current_render_el->component_instance = NULL;
-        current_render_el->custom_properties = NULL;
-        current_render_el->custom_prop_count = 0;
+        current_render_el->cold->is_component_instance = false;
+        current_render_el->cold->component_instance = NULL;
+        current_render_el->cold->custom_properties = NULL;
+        current_render_el->cold->custom_prop_count = 0;
         current_render_el->is_visible = true; // Default to visible
         
-        for(int k=0; k<MAX_ELEMENTS; ++k) current_render_el->children[k] = NULL;
+        current_render_el->children = NULL;
+        current_render_el->child_capacity = 0;
         current_render_el->render_x = 0;
         current_render_el->render_y = 0;
         current_render_el->render_w = 0;
         current_render_el->render_h = 0;
 
         // Set interactivity
-        current_render_el->is_interactive = (current_render_el->header.type == ELEM_TYPE_BUTTON);
+        current_render_el->is_interactive = (current_render_el->type == ELEM_TYPE_BUTTON);
 
         // Copy custom properties if present
         if (doc.elements[i].custom_prop_count > 0 && doc.custom_properties && doc.custom_properties[i]) {
-            current_render_el->custom_prop_count = doc.elements[i].custom_prop_count;
-            current_render_el->custom_properties = calloc(current_render_el->custom_prop_count, sizeof(KrbCustomProperty));
-            if (current_render_el->custom_properties) {
-                for (uint8_t j = 0; j < current_render_el->custom_prop_count; j++) {
-                    current_render_el->custom_properties[j] = doc.custom_properties[i][j];
+            current_render_el->cold->custom_prop_count = doc.elements[i].custom_prop_count;
+            current_render_el->cold->custom_properties = calloc(current_render_el->cold->custom_prop_count, sizeof(KrbCustomProperty));
+            if (current_render_el->cold->custom_properties) {
+                for (uint8_t j = 0; j < current_render_el->cold->custom_prop_count; j++) {
+                    current_render_el->cold->custom_properties[j] = doc.custom_properties[i][j];
                 }
             }
         }
 
         // Apply Style FIRST
-        if (current_render_el->header.style_id > 0 && current_render_el->header.style_id <= doc.header.style_count) {
-            int style_idx = current_render_el->header.style_id - 1;
+        if (current_render_el->cold->header.style_id > 0 && current_render_el->cold->header.style_id <= doc.header.style_count) {
+            int style_idx = current_render_el->cold->header.style_id - 1;
              if (doc.styles && style_idx >= 0) {
                  KrbStyle* style = &doc.styles[style_idx];
                  for(int j=0; j<style->property_count; ++j) {
@@ -340,7 +341,7 @@ int main(int argc, char* argv[]) {
 
         // Apply Direct Properties SECOND
         if (doc.properties && i < doc.header.element_count && doc.properties[i]) {
-             for (int j = 0; j < current_render_el->header.property_count; j++) {
+             for (int j = 0; j < current_render_el->cold->header.property_count; j++) {
                  apply_property_to_element(current_render_el, &doc.properties[i][j], &doc, debug_file);
             }
         }
@@ -352,52 +353,18 @@ int main(int argc, char* argv[]) {
         calculate_element_minimum_size(&ctx->elements[i], ctx->scale_factor);
     }
 
-    // --- Process Component Instances ---
-    if (!process_component_instances(ctx, debug_file)) {
-        fprintf(stderr, "ERROR: Failed to process component instances\n");
+    // --- Build Parent/Child Tree (from the child links resolved by the reader) ---
+    build_element_tree(ctx, debug_file);
+
+    // --- Expand Component Instances ---
+    if (!expand_all_components(ctx, debug_file)) {
+        fprintf(stderr, "ERROR: Failed to expand component instances\n");
         free_render_context(ctx);
         krb_free_document(&doc);
         if (debug_file != stderr) fclose(debug_file);
         return 1;
     }
 
-    // --- Connect component children ---
-    connect_component_children(ctx, debug_file);
-
-    // --- Build Parent/Child Tree ---
-    fprintf(debug_file, "INFO: Building element tree...\n");
-    RenderElement* parent_stack[MAX_ELEMENTS]; 
-    int stack_top = -1;
-    
-    for (int i = 0; i < doc.header.element_count; i++) {
-        RenderElement* current_el = &ctx->elements[i];
-        
-        if (current_el->is_placeholder) continue;
-        
-        while (stack_top >= 0) {
-            RenderElement* p = parent_stack[stack_top];
-            if (p->child_count >= p->header.child_count) {
-                stack_top--;
-            } else {
-                break;
-            }
-        }
-        
-        if (stack_top >= 0) {
-            RenderElement* cp = parent_stack[stack_top];
-            current_el->parent = cp;
-            if (cp->child_count < MAX_ELEMENTS) {
-                cp->children[cp->child_count++] = current_el;
-            }
-        }
-        
-        if (current_el->header.child_count > 0) {
-            if (stack_top + 1 < MAX_ELEMENTS) {
-                parent_stack[++stack_top] = current_el;
-            }
-        }
-    }
-
     // Add component instance roots to the tree
     ComponentInstance* instance = ctx->instances;
     while (instance) {
@@ -426,20 +393,27 @@ int main(int argc, char* argv[]) {
     }
 
     // --- Find Roots ---
-    RenderElement* root_elements[MAX_ELEMENTS]; 
+    // Every root is an element, so element_count bounds the list; the context owns and frees it
+    RenderElement** root_elements = calloc(ctx->element_count ? ctx->element_count : 1, sizeof(RenderElement*));
     int root_count = 0;
+    if (!root_elements) {
+        perror("calloc root elements");
+        free_render_context(ctx);
+        krb_free_document(&doc);
+        if(debug_file!=stderr) fclose(debug_file);
+        return 1;
+    }
+    ctx->roots = root_elements;
     
     for(int i = 0; i < doc.header.element_count; ++i) {
         if (!ctx->elements[i].parent && !ctx->elements[i].is_placeholder) {
-            if (root_count < MAX_ELEMENTS) {
-                root_elements[root_count++] = &ctx->elements[i];
-            }
+            root_elements[root_count++] = &ctx->elements[i];
         }
     }
     
     // Add component instance roots
     instance = ctx->instances;
-    while (instance && root_count < MAX_ELEMENTS) {
+    while (instance) {
         if (instance->root && !instance->root->parent) {
             root_elements[root_count++] = instance->root;
         }
@@ -454,22 +428,33 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    ctx->root_count = root_count;
     fprintf(debug_file, "INFO: Found %d root element(s).\n", root_count);
 
+    // --- Precompute State Paint (hover, pressed, focused) ---
+    resolve_all_state_properties(ctx, debug_file);
+
     // --- Set initial tab visibility ---
     update_tab_visibility(ctx);
 
+    // --- Bind Event Callbacks ---
+    EventDispatcher events;
+    init_event_dispatcher(&events, ctx);
+    register_event_callback(&events, "showHomePage", showHomePage, ctx);
+    register_event_callback(&events, "showSearchPage", showSearchPage, ctx);
+    register_event_callback(&events, "showProfilePage", showProfilePage, ctx);
+    resolve_event_handlers(&events, debug_file);
+
     // --- Init Raylib Window ---
     InitWindow(ctx->window_width, ctx->window_height, ctx->window_title ? ctx->window_title : "KRB TabBar Example");
     if (ctx->resizable) SetWindowState(FLAG_WINDOW_RESIZABLE);
     SetTargetFPS(60);
+    // Nothing animates here, so the loop can always sleep until the next input event
+    EnableEventWaiting();
     fprintf(debug_file, "INFO: Entering main loop...\n");
 
     // --- Main Loop ---
     while (!WindowShouldClose()) {
-        Vector2 mousePos = GetMousePosition();
-        bool mouse_clicked = IsMouseButtonPressed(MOUSE_BUTTON_LEFT);
-
         // --- Window Resizing ---
          if (ctx->resizable && IsWindowResized()) {
             ctx->window_width = GetScreenWidth(); 
@@ -479,68 +464,33 @@ int main(int argc, char* argv[]) {
                 app_element->render_h = ctx->window_height; 
             }
              fprintf(debug_file, "INFO: Window resized to %dx%d\n", ctx->window_width, ctx->window_height);
+             mark_layout_dirty(ctx);
         }
 
-        // --- Interaction Check & Callback Execution ---
-        SetMouseCursor(MOUSE_CURSOR_DEFAULT);
-        for (int i = doc.header.element_count - 1; i >= 0; --i) {
-             RenderElement* el = &ctx->elements[i];
-             if (el->is_placeholder || !el->is_visible) continue;
-             
-             if (el->is_interactive && el->render_w > 0 && el->render_h > 0) {
-                Rectangle elementRect = { (float)el->render_x, (float)el->render_y, (float)el->render_w, (float)el->render_h };
-                if (CheckCollisionPointRec(mousePos, elementRect)) {
-                    SetMouseCursor(MOUSE_CURSOR_POINTING_HAND);
-                    if (mouse_clicked) {
-                         int original_idx = el->original_index;
-                         if (doc.events && original_idx < doc.header.element_count && doc.events[original_idx]) {
-                            for (int k = 0; k < doc.elements[original_idx].event_count; k++) {
-                                KrbEventFileEntry* event = &doc.events[original_idx][k];
-                                if (event->event_type == EVENT_TYPE_CLICK) {
-                                    uint8_t callback_idx = event->callback_id;
-                                    if (callback_idx < doc.header.string_count && doc.strings[callback_idx]) {
-                                        const char* handler_name = doc.strings[callback_idx];
-                                        KrbEventHandlerFunc handler_func = find_handler(handler_name);
-                                        if (handler_func) {
-                                            fprintf(debug_file, "INFO: Executing click handler '%s' for element %d\n", handler_name, original_idx);
-                                            handler_func();
-                                            // Update tab visibility after handler execution
-                                            update_tab_visibility(ctx);
-                                        }
-                                    }
-                                    goto end_interaction_check;
-                                }
-                            }
-                         }
-                    }
-                    break;
-                }
-            }
-        }
-        end_interaction_check:;
+        // --- Event Dispatch ---
+        // Runs bound callbacks for pointer events on the element under the cursor
+        dispatch_pointer_events(&events, debug_file);
 
         // --- Drawing ---
-        BeginDrawing();
-        Color clear_color = BLACK;
-        if (app_element) {
-            clear_color = app_element->bg_color;
-        } else if (root_count > 0) {
-            clear_color = root_elements[0]->bg_color;
-        }
-        ClearBackground(clear_color);
-
-        // Render roots
-        for (int i = 0; i < root_count; ++i) {
-            if (root_elements[i]) {
-                render_element(root_elements[i], 0, 0, ctx->window_width, ctx->window_height, ctx->scale_factor, debug_file);
+        // Layout and the draw list are only rebuilt after a resize, hover or visibility
+        // change; otherwise the last frame is still on screen and we just wait for input
+        if (prepare_frame(ctx, debug_file)) {
+            Color clear_color = BLACK;
+            if (app_element) {
+                clear_color = app_element->bg_color;
+            } else if (root_count > 0) {
+                clear_color = root_elements[0]->bg_color;
             }
+            present_frame(ctx, clear_color);
+        } else {
+            PollInputEvents();
         }
-
-        EndDrawing();
     }
 
     // --- Cleanup ---
     fprintf(debug_file, "INFO: Closing window and cleaning up...\n");
+    free_event_dispatcher(&events);
+    unload_backbuffer(ctx);
     CloseWindow();
 
     free_render_context(ctx);
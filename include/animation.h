@@ -0,0 +1,56 @@
+#ifndef KRB_ANIMATION_H
+#define KRB_ANIMATION_H
+
+#include "renderer.h"
+
+// What an update_animations() call invalidated
+#define ANIM_DIRTY_PAINT  (1 << 0)  // Colors or opacity changed; a redraw is enough
+#define ANIM_DIRTY_LAYOUT (1 << 1)  // Sizes may have changed; animated elements were re-measured
+
+// One animation ref of a render element, resolved against the document
+typedef struct {
+    RenderElement* element;
+    const KrbAnimation* animation;
+    uint8_t trigger;         // ANIM_TRIGGER_*
+    bool pointer_inside;     // Hover edge detection
+} AnimationBinding;
+
+// A running animation. Active runs are packed at the front of the engine's array so the
+// per-frame update is a single linear pass over them.
+typedef struct {
+    RenderElement* element;
+    const KrbAnimation* animation;
+    double start_time;
+    bool affects_layout;     // Any track drives a property other than color/opacity
+} AnimationRun;
+
+typedef struct {
+    KrbDocument* doc;
+    float scale_factor;
+    AnimationBinding* bindings;
+    int binding_count;
+    AnimationRun* runs;
+    int run_count;
+    int run_capacity;
+} AnimationEngine;
+
+// Binds the animation refs of every document element and component instance in 'ctx'.
+// Call after components are expanded; ANIM_TRIGGER_LOAD animations start at 'now'.
+bool init_animation_engine(AnimationEngine* engine, RenderContext* ctx, double now, FILE* debug_file);
+void free_animation_engine(AnimationEngine* engine);
+
+// Starts (or restarts) 'animation' on 'element'
+bool start_animation(AnimationEngine* engine, RenderElement* element, const KrbAnimation* animation, double now);
+// Starts every animation bound to 'element' with 'trigger' (NULL element: any element)
+void trigger_animations(AnimationEngine* engine, RenderElement* element, uint8_t trigger, double now);
+// Fires hover and press triggers from the frame's pointer query: 'hovered' is ctx->hovered
+// and 'pressed' the element the button went down on this frame (NULL if none), so only the
+// topmost element under the pointer reacts
+void update_animation_triggers(AnimationEngine* engine, RenderElement* hovered, RenderElement* pressed, double now);
+
+// Advances every running animation to 'now' in one pass and applies the sampled values.
+// Finished runs are retired after their final value is applied. Returns ANIM_DIRTY_* bits.
+uint8_t update_animations(AnimationEngine* engine, double now);
+bool animations_running(const AnimationEngine* engine);
+
+#endif // KRB_ANIMATION_H
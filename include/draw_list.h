@@ -0,0 +1,54 @@
+#ifndef KRB_DRAW_LIST_H
+#define KRB_DRAW_LIST_H
+
+#include <stdbool.h>
+#include "raylib.h"
+
+typedef enum {
+    DRAW_CMD_RECT,           // Filled rectangle (backgrounds and border edges)
+    DRAW_CMD_TEXT,           // Text run at rect.x/rect.y
+    DRAW_CMD_TEXTURE,        // Texture stretched from 'source' into rect
+    DRAW_CMD_SCISSOR_BEGIN,  // Clip following commands to rect
+    DRAW_CMD_SCISSOR_END
+} DrawCommandType;
+
+typedef struct {
+    DrawCommandType type;
+    Color color;
+    Rectangle rect;
+    union {
+        struct {
+            const char* text;    // Borrowed from the element; changing text must rebuild the list
+            int font_size;
+        } text;
+        struct {
+            Texture2D texture;
+            Rectangle source;
+        } texture;
+    };
+} DrawCommand;
+
+// A frame's drawing as a flat array, replayed front to back
+typedef struct {
+    DrawCommand* commands;
+    int count;
+    int capacity;
+} DrawList;
+
+// Empties the list but keeps its storage for the next recording
+void clear_draw_list(DrawList* list);
+void free_draw_list(DrawList* list);
+
+bool draw_list_rect(DrawList* list, int x, int y, int w, int h, Color color);
+bool draw_list_text(DrawList* list, const char* text, int x, int y, int font_size, Color color);
+bool draw_list_texture(DrawList* list, Texture2D texture, Rectangle source, Rectangle dest, Color tint);
+bool draw_list_scissor_begin(DrawList* list, int x, int y, int w, int h);
+bool draw_list_scissor_end(DrawList* list);
+
+// Issues every command with raylib; call between BeginDrawing() and EndDrawing()
+void replay_draw_list(const DrawList* list);
+// Replays only what can touch 'clip': everything is scissored to it (command scissors are
+// intersected with it) and rects, textures and scissored runs outside it are skipped
+void replay_draw_list_clipped(const DrawList* list, Rectangle clip);
+
+#endif // KRB_DRAW_LIST_H
@@ -0,0 +1,54 @@
+#ifndef KRB_EVENT_DISPATCH_H
+#define KRB_EVENT_DISPATCH_H
+
+#include "renderer.h"
+
+// One handler slot per event type EVENT_TYPE_CLICK (slot 0) .. EVENT_TYPE_CUSTOM
+#define EVENT_SLOT_COUNT EVENT_TYPE_CUSTOM
+
+typedef void (*KrbEventCallback)(RenderElement* element, uint8_t event_type, void* user_data);
+
+typedef struct {
+    const char* name;           // Callback name as written in the KRB string table
+    KrbAtom atom;               // 'name' in the loaded document, set by resolve_event_handlers()
+    KrbEventCallback callback;
+    void* user_data;
+} EventCallbackEntry;
+
+// Routes element events to C callbacks. Callbacks are registered by name once; at load,
+// every element's event entries are resolved to callback indices, so dispatching is an
+// indexed load and a direct call.
+typedef struct {
+    RenderContext* ctx;
+    EventCallbackEntry* callbacks;
+    int callback_count;
+    int callback_capacity;
+    int16_t* handlers;          // [element index * EVENT_SLOT_COUNT + slot] -> callback, -1 if none
+    int handler_element_count;
+
+    // Pointer state for dispatch_pointer_events(); the hovered element is ctx->hovered
+    RenderElement* pressed;
+    RenderElement* focused;
+} EventDispatcher;
+
+void init_event_dispatcher(EventDispatcher* dispatcher, RenderContext* ctx);
+void free_event_dispatcher(EventDispatcher* dispatcher);
+
+// 'name' must outlive the dispatcher (string literals in practice)
+bool register_event_callback(EventDispatcher* dispatcher, const char* name, KrbEventCallback callback, void* user_data);
+// Binds the event entries of every document element and component instance to registered
+// callbacks. Call after components are expanded and callbacks registered; names without
+// a callback are reported to debug_file and left unbound.
+bool resolve_event_handlers(EventDispatcher* dispatcher, FILE* debug_file);
+
+// Calls the callback bound to 'element' for 'event_type'; returns whether one ran
+bool dispatch_event(EventDispatcher* dispatcher, RenderElement* element, uint8_t event_type);
+// Fires the pointer-driven events for this frame from the update_hover_state() query
+// (laying out first if needed), which prepare_frame() then reuses:
+// HOVER when it enters an element, PRESS/RELEASE for the left button, CLICK on a release
+// over the pressed element, and BLUR/FOCUS when a press moves focus. The pressed and
+// focused elements get STATE_ACTIVE and STATE_FOCUS. Run it before prepare_frame() so
+// changes made by callbacks are presented in the same frame.
+void dispatch_pointer_events(EventDispatcher* dispatcher, FILE* debug_file);
+
+#endif // KRB_EVENT_DISPATCH_H
@@ -2,18 +2,31 @@
 #define KRB_H
 
 #include <stdint.h>
+#include <stddef.h>  // For size_t
+#ifndef KRB_NO_STDIO
 #include <stdio.h>   // For FILE*
+#endif
 #include <stdbool.h> // For bool type
 
-// Define MAX_ELEMENTS if not defined elsewhere
-#ifndef MAX_ELEMENTS
-#define MAX_ELEMENTS 256
-#endif
 
-// --- Constants from KRB v0.5 Specification ---
+// --- Constants from KRB v0.6 Specification ---
 
 #define KRB_SPEC_VERSION_MAJOR 0
-#define KRB_SPEC_VERSION_MINOR 5  // Updated to v0.5
+#define KRB_SPEC_VERSION_MINOR 6  // v0.6: 16-bit string/style/child indices (see "Wide Indices")
+#define KRB_SPEC_VERSION_MINOR_COMPAT 5 // Oldest revision the reader accepts
+
+// Wide Indices (v0.6). Files with minor version >= 6 store, in place of v0.5's single byte:
+//   - element id, style id and child count as u16 (element header grows to 21 bytes)
+//   - event callback, custom property key, style/component/property-def/script/entry-point/
+//     resource/animation name and resource data string indices as u16
+//   - style ids in the style table as u16
+//   - string lengths as an unsigned LEB128 varint
+// Everything else (counts of properties, events, etc.) keeps the v0.5 encoding. In both
+// revisions a VAL_TYPE_STRING / VAL_TYPE_RESOURCE value is a 1- or 2-byte (LE) index.
+#define KRB_WIDE_INDEX_MINOR 6
+
+// Sentinel for "no element" in parsed element/template index fields
+#define KRB_INVALID_INDEX 0xFFFF
 
 // Header Flags
 #define FLAG_HAS_STYLES        (1 << 0)
@@ -111,6 +124,25 @@
 #define EVENT_TYPE_CUSTOM   0x0A
 // 0x0B-0xFF Reserved
 
+// Animation Easing Curves
+#define ANIM_EASE_LINEAR    0x00
+#define ANIM_EASE_IN        0x01
+#define ANIM_EASE_OUT       0x02
+#define ANIM_EASE_IN_OUT    0x03
+// 0x04-0xFF Reserved (treated as linear)
+
+// Animation Flags
+#define ANIM_FLAG_LOOP      (1 << 0)  // Restart when the end is reached
+#define ANIM_FLAG_ALTERNATE (1 << 1)  // With LOOP, every other pass runs backwards
+// Bits 2-7 Reserved
+
+// Animation Triggers (second byte of an element's animation ref)
+#define ANIM_TRIGGER_LOAD   0x00  // Starts when the document is shown
+#define ANIM_TRIGGER_HOVER  0x01  // Starts when the pointer enters the element
+#define ANIM_TRIGGER_PRESS  0x02  // Starts when the element is pressed
+#define ANIM_TRIGGER_MANUAL 0x03  // Only started from code
+// 0x04-0xFF Reserved
+
 // Layout Byte Bits
 #define LAYOUT_DIRECTION_MASK 0x03
 #define LAYOUT_ALIGNMENT_MASK 0x0C
@@ -155,7 +187,7 @@
 
 #pragma pack(push, 1)
 
-// KRB v0.5 Header Structure (54 bytes) - Updated from v0.4 (48 bytes)
+// KRB Header Structure (54 bytes since v0.5; v0.4 used 48)
 typedef struct {
     char magic[4];           // "KRB1"
     uint16_t version;        // Minor << 8 | Major (e.g., 0x0005 for 0.5)
@@ -177,34 +209,41 @@ typedef struct {
     uint32_t total_size;
 } KrbHeader;
 
-// Element Header (18 bytes) - Updated from v0.4 (17 bytes)
+// Element Header (18 bytes in v0.5, 21 in v0.6)
 typedef struct {
     uint8_t type;
-    uint8_t id;              // 0-based string index
+    uint16_t id;             // 0-based string index
     uint16_t pos_x;
     uint16_t pos_y;
     uint16_t width;
     uint16_t height;
     uint8_t layout;
-    uint8_t style_id;        // 1-based style ID
+    uint16_t style_id;       // 1-based style ID
     uint8_t property_count;
-    uint8_t child_count;
+    uint16_t child_count;
     uint8_t event_count;
     uint8_t animation_count;
     uint8_t custom_prop_count;
     uint8_t state_prop_count; // NEW: Number of state property sets
 } KrbElementHeader;
 
-// Event structure (as stored in file - 2 bytes)
+
+// Element animation ref (as stored in file - 2 bytes)
 typedef struct {
-    uint8_t event_type;
-    uint8_t callback_id;   // 0-based string index
-} KrbEventFileEntry;
+    uint8_t animation_index; // 0-based index into the animation table
+    uint8_t trigger;         // ANIM_TRIGGER_*
+} KrbAnimationRef;
 
 #pragma pack(pop)
 
 // Structures representing data parsed into memory (don't need packing)
 
+// Event entry (2 bytes in v0.5 files, 3 in v0.6)
+typedef struct {
+    uint8_t event_type;
+    uint16_t callback_id;  // 0-based string index
+} KrbEventFileEntry;
+
 typedef struct {
     uint8_t property_id;
     uint8_t value_type;
@@ -212,9 +251,19 @@ typedef struct {
     void* value;
 } KrbProperty;
 
+// Presence mask and dense slot index over one property array, built at parse time.
+// Bit N of 'mask' is set when PROP_ID N (N < 64) occurs; its slot is the number of set
+// bits below N, and slots[slot] is the position of its last occurrence in the array.
+typedef struct {
+    uint64_t mask;
+    uint8_t* slots;
+} KrbPropertyIndex;
+
+#define KRB_PROPERTY_INDEX_LIMIT 64
+
 // Custom Property structure
 typedef struct {
-    uint8_t key_index;      // 0-based string table index for property key name
+    uint16_t key_index;     // 0-based string table index for property key name
     uint8_t value_type;     // VAL_TYPE_* for the value
     uint8_t value_size;     // Size of value in bytes
     void* value;            // Property value data
@@ -229,59 +278,105 @@ typedef struct {
 
 // NEW: Script Function structure
 typedef struct {
-    uint8_t function_name_index; // String table index for function name
+    uint16_t function_name_index; // String table index for function name
 } KrbScriptFunction;
 
 // NEW: Script Entry structure
 typedef struct {
     uint8_t language_id;         // Script language identifier
-    uint8_t name_index;          // String table index for script name (0 if unnamed)
+    uint16_t name_index;         // String table index for script name (0 if unnamed)
     uint8_t storage_format;      // How script is stored (inline/external)
     uint8_t entry_point_count;   // Number of exported functions
     uint16_t data_size;          // Size if inline, resource index if external
     KrbScriptFunction* entry_points; // Array of entry point functions
     void* code_data;             // Script code (for inline scripts only)
-    uint8_t resource_index;      // Resource index (for external scripts only)
+    uint16_t resource_index;     // Resource index (for external scripts only)
 } KrbScript;
 
+// Animation table entry, as stored in file:
+//   NameIdx(1, u16 in v0.6) Duration(2, ms) Easing(1) Flags(1) TrackCount(1)
+//   per track: PropertyId(1) ValueType(1) ValueSize(1) KeyframeCount(1)
+//              per keyframe: Offset(1) Value(ValueSize)
+// A keyframe's offset maps 0-255 onto the duration; offsets never decrease within a track.
+typedef struct {
+    uint8_t offset;
+    const uint8_t* value;   // value_size bytes, borrowed from the document's backing buffer
+} KrbKeyframe;
+
+typedef struct {
+    uint8_t property_id;    // PROP_ID_* the track drives
+    uint8_t value_type;     // VAL_TYPE_* of every keyframe value (never STRING or RESOURCE)
+    uint8_t value_size;
+    uint8_t keyframe_count; // At least 1
+    KrbKeyframe* keyframes;
+} KrbAnimationTrack;
+
+typedef struct {
+    uint16_t name_index;    // 0-based string table index
+    uint16_t duration_ms;
+    uint8_t easing;         // ANIM_EASE_*
+    uint8_t flags;          // ANIM_FLAG_*
+    uint8_t track_count;
+    KrbAnimationTrack* tracks;
+} KrbAnimation;
+
 // Property Definition structure (for component definitions)
 typedef struct {
-    uint8_t name_index;     // 0-based string table index for property name
+    uint16_t name_index;    // 0-based string table index for property name
     uint8_t value_type_hint; // VAL_TYPE_* indicating expected data type
     uint8_t default_value_size; // Size of default value (0 if no default)
     void* default_value_data;   // Default value data (NULL if no default)
 } KrbPropertyDefinition;
 
+// One element of a component template. Templates are stored in pre-order, so a
+// parent always precedes its children and element 0 is the template root.
+typedef struct {
+    KrbElementHeader header;
+    KrbProperty* properties;
+    KrbPropertyIndex property_index;
+    KrbCustomProperty* custom_properties;
+    KrbStatePropertySet* state_properties;
+    KrbEventFileEntry* events;
+    KrbAnimationRef* animation_refs;
+    uint16_t parent_index;   // Index of the parent in the template; KRB_INVALID_INDEX for the root
+} KrbTemplateElement;
+
 // Component Definition structure
 typedef struct {
-    uint8_t name_index;         // 0-based string table index for component name
+    uint16_t name_index;        // 0-based string table index for component name
     uint8_t property_def_count; // Number of property definitions
     KrbPropertyDefinition* property_defs; // Array of property definitions
-    // Root element template follows as a complete KRB Element Block
+    // Complete template subtree, fully decoded and immutable after load
+    KrbTemplateElement* template_elements;
+    uint16_t template_element_count;
+    // Convenience copies of template_elements[0]
     KrbElementHeader root_template_header;
     KrbProperty* root_template_properties;    // Standard properties for root template
     KrbCustomProperty* root_template_custom_props; // Custom properties for root template (typically 0)
     KrbStatePropertySet* root_template_state_props; // NEW: State properties for root template
     KrbEventFileEntry* root_template_events;  // Events for root template (typically 0)
-    // Child references would follow, but for simplicity we'll handle this in parsing
 } KrbComponentDefinition;
 
 typedef struct {
-    uint8_t id;
-    uint8_t name_index;
+    uint16_t id;
+    uint16_t name_index;
     uint8_t property_count;
     KrbProperty* properties;
+    KrbPropertyIndex property_index;
 } KrbStyle;
 
 typedef struct {
     uint8_t type;
-    uint8_t name_index;
+    uint16_t name_index;
     uint8_t format;
-    uint8_t data_string_index; // Only if format is External
-    // void* inline_data;    // TODO for inline
-    // size_t inline_data_size; // TODO for inline
+    uint16_t data_string_index; // Only if format is External
+    const uint8_t* inline_data; // Only if format is Inline; points into the document's backing buffer
+    size_t inline_data_size;
 } KrbResource;
 
+// Opaque block of the per-document allocation arena (see krb_reader.c)
+typedef struct KrbArenaBlock KrbArenaBlock;
+
 // Represents the entire parsed KRB document data in memory
 typedef struct {
     KrbHeader header; // Copy of the raw header data
@@ -292,29 +387,119 @@ typedef struct {
 
     // Arrays holding parsed data
     KrbElementHeader* elements;
+    uint32_t* element_offsets;             // Byte offset of each element header in 'element_section'
+    bool* element_decoded;                 // Body (props, state sets, events) decoded yet?
+    // Element tree resolved from the serialized child refs; KRB_INVALID_INDEX where absent
+    uint16_t* element_parent;
+    uint16_t* element_first_child;
+    uint16_t* element_next_sibling;
     KrbProperty** properties;              // Standard properties per element
+    KrbPropertyIndex* property_index;      // Presence mask / slot index over 'properties' per element
     KrbCustomProperty** custom_properties; // Custom properties per element
     KrbStatePropertySet** state_properties; // NEW: State property sets per element
     KrbEventFileEntry** events;
+    KrbAnimationRef** animation_refs;       // Animation refs per element
     KrbStyle* styles;
     KrbComponentDefinition* component_defs;
     KrbScript* scripts;                     // NEW: Script blocks
     char** strings;
+    // String interning: a string's atom is the index of its first occurrence in 'strings',
+    // so equal names compare equal as integers. 'string_slots' is an open-addressed hash
+    // index (KRB_INVALID_INDEX marks an empty slot) used to resolve C strings to atoms.
+    uint16_t* string_atoms;      // Atom of each string table entry
+    uint32_t* string_hashes;     // Hash of each string table entry
+    uint16_t* string_slots;
+    uint32_t string_slot_mask;   // Slot count - 1 (slot count is a power of two)
     KrbResource* resources;
-    // KrbAnimation* animations; // TODO
+    KrbAnimation* animations;
+
+    // Backing store the document was parsed from. Property, custom property, event
+    // and script data point into it instead of the heap.
+    const uint8_t* data;
+    size_t data_size;
+    bool data_is_mapped;   // data came from mmap() and is unmapped by krb_free_document
+    bool data_is_owned;    // data was read by krb_read_document and is freed by krb_free_document
+    const uint8_t* element_section; // Element bytes: aliases 'data', or the inflated copy if compressed
+    size_t element_section_size;
+
+    // FLAG_COMPRESSED accounting: on-disk vs. inflated bytes of the sections read so far
+    size_t compressed_bytes;
+    size_t uncompressed_bytes;
+    uint16_t sections_decompressed;
+
+    // Owns every array and copied value above; released in one pass by krb_free_document
+    KrbArenaBlock* arena;
 
 } KrbDocument;
 
 // --- Function Prototypes for krb_reader.c ---
 
+// Load flags for the *_ex loaders
+#define KRB_LOAD_LAZY_ELEMENTS 0x01 // Only skim elements at load; decode each on first krb_get_element*()
+#define KRB_LOAD_PARALLEL      0x02 // Decode independent sections on a small thread pool (ignored with KRB_NO_THREADS)
+
+// Parses a caller-owned KRB image (e.g. an array embedded with xxd) in place with
+// bounds-checked reads. The buffer must outlive the document.
+bool krb_read_document_from_buffer(const uint8_t* data, size_t size, KrbDocument* doc);
+bool krb_read_document_from_buffer_ex(const uint8_t* data, size_t size, uint32_t load_flags, KrbDocument* doc);
+
+// Stream and file loaders. Define KRB_NO_STDIO for embedded builds that only
+// parse from buffers; the reader then pulls in neither stdio nor POSIX I/O.
+#ifndef KRB_NO_STDIO
 // Reads the entire KRB document structure into memory.
 bool krb_read_document(FILE* file, KrbDocument* doc);
+bool krb_read_document_ex(FILE* file, uint32_t load_flags, KrbDocument* doc);
+
+// Maps a KRB file read-only with mmap() and parses it without copying property values.
+bool krb_map_document(const char* path, KrbDocument* doc);
+bool krb_map_document_ex(const char* path, uint32_t load_flags, KrbDocument* doc);
+#endif
 
-// Frees all memory dynamically allocated by krb_read_document.
+// Element accessors. Headers are always available after load; with KRB_LOAD_LAZY_ELEMENTS
+// the per-element arrays (properties, custom_properties, state_properties, events, animation_refs) stay
+// NULL until these decode them. Lazy decoding writes to the document and is not thread-safe.
+const KrbElementHeader* krb_get_element(KrbDocument* doc, uint16_t index);
+KrbProperty* krb_get_element_properties(KrbDocument* doc, uint16_t index);
+
+// Interned string lookup. An atom is a string table index, so doc->strings[atom] is the
+// name; both return KRB_INVALID_ATOM when the name is absent or the index is out of range.
+typedef uint16_t KrbAtom;
+#define KRB_INVALID_ATOM KRB_INVALID_INDEX
+KrbAtom krb_find_atom(const KrbDocument* doc, const char* name);
+KrbAtom krb_string_atom(const KrbDocument* doc, uint16_t index);
+
+// O(1) property queries: a bit test on the index, then one array read. A NULL index
+// (and any id >= KRB_PROPERTY_INDEX_LIMIT) falls back to a scan. The last occurrence of
+// an id wins, matching apply-in-order semantics.
+const KrbProperty* krb_find_property(const KrbProperty* props, uint8_t count, const KrbPropertyIndex* index, uint8_t property_id);
+const KrbProperty* krb_get_element_property(KrbDocument* doc, uint16_t element, uint8_t property_id);
+const KrbProperty* krb_get_style_property(const KrbDocument* doc, uint16_t style_id, uint8_t property_id);
+// (Re)builds an index after a property array is edited; slots come from the document arena.
+bool krb_index_properties(KrbDocument* doc, const KrbProperty* props, uint8_t count, KrbPropertyIndex* index);
+
+// Frees all memory dynamically allocated by any of the krb_read_*/krb_map_* loaders.
 void krb_free_document(KrbDocument* doc);
 
+// Allocates zeroed memory that lives exactly as long as the document.
+void* krb_document_alloc(KrbDocument* doc, size_t size);
+
 // Helpers for reading little-endian values
 uint16_t krb_read_u16_le(const void* data);
 uint32_t krb_read_u32_le(const void* data);
 
+// Decodes a VAL_TYPE_STRING / VAL_TYPE_RESOURCE value (1 byte, or 2 bytes LE). Returns
+// false for any other size.
+bool krb_read_ref_value(const void* value, uint8_t size, uint16_t* out_index);
+
+// --- Function Prototypes for krb_writer.c ---
+
+// Serializes a document as an uncompressed image with freshly computed section offsets,
+// flags and total_size. The output is v0.5 unless the document needs wide indices (v0.6). Elements must be in pre-order (as the reader produces).
+// Caller frees *out_data.
+bool krb_write_document_to_buffer(KrbDocument* doc, uint8_t** out_data, size_t* out_size);
+
+#ifndef KRB_NO_STDIO
+bool krb_write_document(KrbDocument* doc, FILE* file);
+#endif
+
 #endif // KRB_H
\ No newline at end of file
@@ -5,75 +5,134 @@
 #include <stdbool.h>
 #include "raylib.h"
 #include "krb.h"
-
-#ifndef MAX_ELEMENTS
-#define MAX_ELEMENTS 256
-#endif
+#include "draw_list.h"
 
 #define MAX_LINE_LENGTH 512
-#define INVALID_RESOURCE_INDEX 0xFF
+#define INVALID_RESOURCE_INDEX 0xFFFF
+#define MAX_DAMAGE_RECTS 16             // Beyond this, damage collapses into its bounding box
+#define HIT_GRID_CELL_SIZE 64           // Pixels per hit grid cell side
 
 // --- Component Instance Tracking ---
 typedef struct ComponentInstance {
-    uint8_t definition_index;           // Index into KrbDocument's component_defs array
+    uint16_t definition_index;          // Index into KrbDocument's component_defs array
     struct RenderElement* placeholder;  // Original placeholder element
     struct RenderElement* root;         // Root of instantiated component tree
     struct ComponentInstance* next;     // For linked list of instances
 } ComponentInstance;
 
 // --- Render Element Structure ---
-typedef struct RenderElement {
-    KrbElementHeader header;
-    char* text;
+// Split by access pattern. Everything the layout/draw walk reads on every element sits in
+// RenderElement itself, packed at the front; data only some elements or passes need
+// (text, textures, custom/state properties, instance links) lives in a RenderElementCold
+// record in a side table parallel to RenderContext.elements.
+
+// Paint fields a state delta overrides
+#define STATE_PAINT_BG      (1 << 0)
+#define STATE_PAINT_FG      (1 << 1)
+#define STATE_PAINT_BORDER  (1 << 2)
+#define STATE_PAINT_OPACITY (1 << 3)
+
+// The paint one combination of STATE_* flags resolves to; only the 'fields' values apply
+typedef struct {
+    uint8_t fields;                      // STATE_PAINT_* bits
+    uint8_t opacity;
     Color bg_color;
     Color fg_color;
     Color border_color;
-    uint8_t border_widths[4];
-    uint8_t text_alignment;
-    struct RenderElement* parent;
-    struct RenderElement* children[MAX_ELEMENTS];
-    int child_count;
-    float font_size;
+} StatePaintDelta;
 
-    // Runtime rendering data
-    int render_x;
-    int render_y;
-    int render_w;
-    int render_h;
-    bool is_interactive;
-    bool is_visible;
-    
-    int original_index;
+typedef struct RenderElementCold {
+    // The element's file header. Layout reads type, layout, position and size from the hot
+    // copies in RenderElement, which are the ones kept up to date; the rest is read here.
+    KrbElementHeader header;
+
+    char* text;
+    // Width of 'text' at measured_font_size; stale once 'text' no longer equals measured_text
+    const char* measured_text;
+    int measured_font_size;
+    int measured_width;
 
     // Resource handling
-    uint8_t resource_index;
-    Texture2D texture;
+    uint16_t resource_index;
     bool texture_loaded;
+    Texture2D texture;
 
     // Component instance tracking
     bool is_component_instance;
-    bool is_placeholder;
     ComponentInstance* component_instance;
-    
+
     // Custom properties support
     KrbCustomProperty* custom_properties;
     uint8_t custom_prop_count;
-    
-    // NEW: State properties support
-    KrbStatePropertySet* state_properties;
+
+    // State properties support
     uint8_t state_prop_count;
     uint8_t current_state;               // Current interaction state flags
-    
-    // NEW: Cursor support
     uint8_t cursor_type;                 // Cursor type for this element
-    
+    KrbStatePropertySet* state_properties; // Borrowed from the document
+    uint8_t state_mask;                  // STATE_* flags that change this element's paint
+    StatePaintDelta* state_deltas;       // One per combination of state_mask bits, built at load
+    StatePaintDelta saved_paint;         // Base values of the fields the current delta overrides
+} RenderElementCold;
+
+typedef struct RenderElement {
+    // Geometry: written by layout, read by draw and hit testing
+    int render_x;
+    int render_y;
+    int render_w;
+    int render_h;
+
+    // Resolved paint
+    Color bg_color;
+    Color fg_color;
+    Color border_color;
+    uint8_t border_widths[4];
+    float font_size;
+    uint8_t text_alignment;
+    uint8_t opacity;                     // 255 = opaque; scales the alpha of everything drawn
+
+    // Flags
+    bool is_visible;
+    bool is_interactive;
+    bool is_placeholder;
+
+    // Tree
+    struct RenderElement* parent;
+    struct RenderElement** children;     // Heap array owned by the element (child_capacity slots)
+    int child_count;
+    int child_capacity;
+
+    // Layout inputs from the element header; see set_element_header()
+    uint8_t type;
+    uint8_t layout;
+    uint16_t pos_x;
+    uint16_t pos_y;
+    uint16_t width;
+    uint16_t height;
+
+    int original_index;
+    RenderElementCold* cold;             // This element's side-table record
 } RenderElement;
 
+// --- Hit Testing ---
+// Uniform grid over the window, rebuilt after each layout. Each cell lists the interactive
+// elements overlapping it in paint order, so a point query scans one short cell list.
+typedef struct {
+    int cell_size;
+    int cols;
+    int rows;
+    int* cell_start;                    // Cell i owns items[cell_start[i] .. cell_start[i + 1])
+    RenderElement** items;
+    int item_count;
+} HitGrid;
+
 // --- Render Context Structure ---
 typedef struct RenderContext {
     KrbDocument* doc;                   // Original KRB document
     RenderElement* elements;            // Array of all render elements (including instantiated ones)
     int element_count;                  // Total number of elements (original + instantiated)
+    int element_capacity;               // Allocated slots; grows when components need more
+    RenderElementCold* cold;            // Cold side table, parallel to elements
     int original_element_count;         // Number of original elements from KRB
     ComponentInstance* instances;       // Linked list of component instances
     
@@ -87,8 +146,21 @@ typedef struct RenderContext {
     char* window_title;
     bool resizable;
 
-    RenderElement* roots[MAX_ELEMENTS];
+    RenderElement** roots;              // Filled by find_root_elements()
     int root_count;
+    bool layout_dirty;                  // Rects are stale; layout_tree() recomputes them
+    bool paint_dirty;                   // draw_list is stale; build_draw_list() re-records it
+    DrawList draw_list;                 // Last recorded frame, replayed until something changes
+
+    // Damage: screen areas whose pixels in the backbuffer are stale
+    Rectangle damage_rects[MAX_DAMAGE_RECTS];
+    int damage_count;
+    bool full_damage;                   // Everything is stale (layout ran, window resized, ...)
+    RenderTexture2D backbuffer;         // Persistent frame; only damaged areas are repainted
+
+    HitGrid hit_grid;                   // Interactive elements by location; see hit_test()
+    RenderElement* hovered;             // Topmost interactive element under the pointer
+    bool hover_current;                 // 'hovered' was queried this frame and no layout ran since
     
     // NEW: Script support (basic - full implementation would require script engines)
     bool scripts_enabled;
@@ -100,7 +172,11 @@ RenderContext* create_render_context(KrbDocument* doc, FILE* debug_file);
 void free_render_context(RenderContext* ctx);
 
 // --- Element Initialization and Setup Functions ---
+// Appends 'child' to 'parent' (does not set child->parent)
+bool append_child_element(RenderElement* parent, RenderElement* child);
 void initialize_render_element(RenderElement* el, KrbElementHeader* header, int index, RenderContext* ctx);
+// Stores 'header' in the element's cold record and copies its layout inputs into the hot one
+void set_element_header(RenderElement* el, const KrbElementHeader* header);
 void process_app_element_properties(RenderElement* app_element, KrbDocument* doc, RenderContext* ctx, FILE* debug_file);
 void apply_element_styling(RenderElement* el, KrbDocument* doc, RenderContext* ctx, FILE* debug_file);
 void build_element_tree(RenderContext* ctx, FILE* debug_file);
@@ -112,22 +188,52 @@ void apply_property_inheritance(RenderContext* ctx, FILE* debug_file);
 void inherit_properties_recursive(RenderElement* el, RenderContext* ctx, FILE* debug_file);
 
 // NEW: State-based property resolution functions
+// Moves 'el' to the STATE_* combination 'new_state' by swapping its precomputed paint delta
+// and damaging the element; pass a NULL ctx when nothing is being damage-tracked. Paint
+// written while a state is shown (e.g. by an animation) is kept as the base when it ends.
 void update_element_state(RenderElement* el, uint8_t new_state, RenderContext* ctx, FILE* debug_file);
+// Precomputes the paint of every combination of the states the element's state property
+// sets name. The element's current paint is its base, so call it once styling and
+// inheritance are final. Buttons without a hover set get a brightened default. To restyle
+// later: save the state, update_element_state(el, 0, ...), apply the new style, call this
+// again, then restore the state.
 void resolve_state_properties(RenderElement* el, RenderContext* ctx, FILE* debug_file);
+// resolve_state_properties() for every element in the context
+void resolve_all_state_properties(RenderContext* ctx, FILE* debug_file);
+// The color the element's current state gives 'base_prop_id', or 'base_color' when it
+// does not override that property
 Color resolve_state_color_property(RenderElement* el, uint8_t base_prop_id, Color base_color);
 
 // --- Component Expansion Functions ---
 bool expand_all_components(RenderContext* ctx, FILE* debug_file);
-bool expand_component_for_element(RenderContext* ctx, RenderElement* element, uint8_t component_name_index, FILE* debug_file);
+bool expand_component_for_element(RenderContext* ctx, RenderElement* element, uint16_t component_name_index, FILE* debug_file);
 bool find_component_name_property(KrbCustomProperty* custom_props, uint8_t custom_prop_count, 
-                                 char** strings, uint8_t* out_component_index);
+                                 KrbDocument* doc, uint16_t* out_component_index);
 
 // --- Layout and Sizing Functions ---
 void calculate_element_minimum_size(RenderElement* el, float scale_factor);
+// Requests a re-layout before the next draw. Window resizes and size-affecting animations
+// mark it themselves; call it after changing an element's visibility, position or layout.
+void mark_layout_dirty(RenderContext* ctx);
+// Re-measures 'el' (after its text, font or size properties changed) and marks the tree dirty
+void invalidate_element_layout(RenderContext* ctx, RenderElement* el);
+// Computes the final rect of every element under 'el' from its parent's content box
+void layout_element(RenderElement* el, int parent_content_x, int parent_content_y,
+                    int parent_content_width, int parent_content_height,
+                    float scale_factor, FILE* debug_file);
+// Lays out all roots if the tree is dirty and clears the flag; returns whether it ran
+bool layout_tree(RenderContext* ctx, FILE* debug_file);
 
 // --- Resource and Texture Functions ---
 void load_all_textures(RenderContext* ctx, const char* base_dir, FILE* debug_file);
 
+// --- Hit Testing Functions ---
+// Rebuilds ctx->hit_grid from the current rects; layout_tree() calls it after each layout
+bool build_hit_grid(RenderContext* ctx);
+void free_hit_grid(HitGrid* grid);
+// Topmost drawn interactive element containing 'point', or NULL
+RenderElement* hit_test(const RenderContext* ctx, Vector2 point);
+
 // --- Window and Event Handling Functions ---
 void handle_window_resize(RenderContext* ctx);
 void handle_mouse_events(RenderContext* ctx, FILE* debug_file);
@@ -136,7 +242,35 @@ void handle_mouse_events(RenderContext* ctx, FILE* debug_file);
 bool load_scripts(RenderContext* ctx, FILE* debug_file);
 bool execute_script_function(RenderContext* ctx, const char* function_name, FILE* debug_file);
 
-// --- Main Rendering Function ---
+// --- Drawing Functions ---
+// Requests a re-record of the draw list (colors, opacity, text or textures changed) and a
+// full repaint. A layout pass marks it as well.
+void mark_paint_dirty(RenderContext* ctx);
+// Like mark_paint_dirty() but only 'rect' (or the element's rect) is repainted. Hover
+// transitions damage the element they happen on.
+void add_damage_rect(RenderContext* ctx, Rectangle rect);
+void damage_element(RenderContext* ctx, RenderElement* el);
+// Refreshes the hovered element (its STATE_HOVER flag) and the cursor from one hit_test()
+// of the pointer. prepare_frame() calls it unless it already ran this frame.
+void update_hover_state(RenderContext* ctx);
+// Appends the draw commands of 'el' and its subtree, using the rects from the last layout
+void record_element(RenderElement* el, float scale_factor, DrawList* list, FILE* debug_file);
+// Re-records ctx->draw_list if paint is dirty and clears the flag; returns whether it ran
+bool build_draw_list(RenderContext* ctx, FILE* debug_file);
+// Brings layout, hover state and the draw list up to date for one main-loop iteration.
+// Returns whether the draw list changed; when it did not, the last presented frame is
+// still current and the loop can skip BeginDrawing()/EndDrawing() and only poll input.
+bool prepare_frame(RenderContext* ctx, FILE* debug_file);
+// Repaints the damaged parts of the backbuffer from the draw list, then blits it to the
+// window as one frame. Call after prepare_frame() returned true; needs an open window.
+void present_frame(RenderContext* ctx, Color clear_color);
+// Releases the backbuffer; call before CloseWindow()
+void unload_backbuffer(RenderContext* ctx);
+// update_hover_state() + build_draw_list() + replay: one frame of a laid-out tree
+void draw_tree(RenderContext* ctx, FILE* debug_file);
+// Records and replays 'el' immediately, without touching the context's list
+void draw_element(RenderElement* el, float scale_factor, FILE* debug_file);
+// Lays out and draws 'el' in one call, for loops that re-layout every frame
 void render_element(RenderElement* el, int parent_content_x, int parent_content_y, 
                    int parent_content_width, int parent_content_height, 
                    float scale_factor, FILE* debug_file);
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "animation.h"
+
+// --- Sampling ---
+
+// Color and opacity only change what is drawn; every other property can change sizes
+static bool property_is_paint_only(uint8_t property_id) {
+    return property_id == PROP_ID_BG_COLOR || property_id == PROP_ID_FG_COLOR ||
+           property_id == PROP_ID_BORDER_COLOR || property_id == PROP_ID_OPACITY;
+}
+
+static double apply_easing(uint8_t easing, double p) {
+    switch (easing) {
+        case ANIM_EASE_IN:     return p * p;
+        case ANIM_EASE_OUT:    return 1.0 - (1.0 - p) * (1.0 - p);
+        case ANIM_EASE_IN_OUT: return p < 0.5 ? 2.0 * p * p : 1.0 - 2.0 * (1.0 - p) * (1.0 - p);
+        default:               return p;
+    }
+}
+
+// Maps elapsed time to a keyframe position (0-255, fractional) after looping and easing
+static float sample_position(const KrbAnimation* anim, double elapsed, bool* finished) {
+    double duration = anim->duration_ms / 1000.0;
+    double p;
+    *finished = false;
+    if (elapsed < 0.0) elapsed = 0.0;
+    if (duration <= 0.0 || (!(anim->flags & ANIM_FLAG_LOOP) && elapsed >= duration)) {
+        p = 1.0;
+        *finished = true;
+    } else {
+        double cycles = floor(elapsed / duration);
+        p = elapsed / duration - cycles;
+        if ((anim->flags & ANIM_FLAG_ALTERNATE) && ((long long)cycles & 1)) p = 1.0 - p;
+    }
+    return (float)(apply_easing(anim->easing, p) * 255.0);
+}
+
+static uint8_t lerp_u8(uint8_t a, uint8_t b, float t) {
+    return (uint8_t)(a + (b - a) * t + 0.5f);
+}
+
+// Numeric types are interpolated per component; anything else steps at the next keyframe
+static void interpolate_value(const KrbAnimationTrack* track, const uint8_t* a, const uint8_t* b, float t, uint8_t* out) {
+    switch (track->value_type) {
+        case VAL_TYPE_BYTE:
+        case VAL_TYPE_COLOR:
+        case VAL_TYPE_EDGEINSETS:
+            for (uint8_t i = 0; i < track->value_size; i++) out[i] = lerp_u8(a[i], b[i], t);
+            return;
+        case VAL_TYPE_SHORT:
+        case VAL_TYPE_PERCENTAGE:
+            if (track->value_size == 2) {
+                uint16_t from = krb_read_u16_le(a), to = krb_read_u16_le(b);
+                uint16_t v = (uint16_t)(from + (to - from) * t + 0.5f);
+                out[0] = (uint8_t)(v & 0xFF);
+                out[1] = (uint8_t)(v >> 8);
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+    memcpy(out, t < 1.0f ? a : b, track->value_size);
+}
+
+// Samples one track at 'position' and applies it like any other property
+static void apply_track(KrbDocument* doc, RenderElement* el, const KrbAnimationTrack* track, float position) {
+    const KrbKeyframe* kf = track->keyframes;
+    uint8_t count = track->keyframe_count;
+    uint8_t k = 0;
+    while (k < count && kf[k].offset < position) k++;
+
+    uint8_t value[255];
+    if (k == 0) {
+        memcpy(value, kf[0].value, track->value_size);
+    } else if (k == count) {
+        memcpy(value, kf[count - 1].value, track->value_size);
+    } else {
+        // kf[k - 1].offset < position <= kf[k].offset, so the span is never zero
+        float t = (position - kf[k - 1].offset) / (float)(kf[k].offset - kf[k - 1].offset);
+        interpolate_value(track, kf[k - 1].value, kf[k].value, t, value);
+    }
+    KrbProperty prop = { track->property_id, track->value_type, track->value_size, value };
+    apply_property_to_element(el, &prop, doc, NULL);
+}
+
+static void remeasure_subtree(RenderElement* el, float scale_factor) {
+    el->render_w = 0;
+    el->render_h = 0;
+    calculate_element_minimum_size(el, scale_factor);
+    for (int i = 0; i < el->child_count; i++) {
+        if (el->children[i]) remeasure_subtree(el->children[i], scale_factor);
+    }
+}
+
+// --- Bindings ---
+
+static bool bind_refs(AnimationEngine* engine, RenderElement* el, const KrbAnimationRef* refs, uint8_t count,
+                      FILE* debug_file) {
+    for (uint8_t r = 0; refs && r < count; r++) {
+        if (refs[r].animation_index >= engine->doc->header.animation_count) {
+            if (debug_file) {
+                fprintf(debug_file, "WARN: Element %d references animation %u of %u\n",
+                        el->original_index, refs[r].animation_index, engine->doc->header.animation_count);
+            }
+            continue;
+        }
+        AnimationBinding* grown = realloc(engine->bindings, (engine->binding_count + 1) * sizeof(AnimationBinding));
+        if (!grown) {
+            perror("realloc animation bindings");
+            return false;
+        }
+        engine->bindings = grown;
+        engine->bindings[engine->binding_count++] = (AnimationBinding){
+            el, &engine->doc->animations[refs[r].animation_index], refs[r].trigger, false
+        };
+    }
+    return true;
+}
+
+bool init_animation_engine(AnimationEngine* engine, RenderContext* ctx, double now, FILE* debug_file) {
+    if (!engine || !ctx || !ctx->doc) return false;
+    memset(engine, 0, sizeof(AnimationEngine));
+    engine->doc = ctx->doc;
+    engine->scale_factor = ctx->scale_factor;
+    KrbDocument* doc = ctx->doc;
+    if (doc->header.animation_count == 0 || !doc->animations) return true;
+
+    for (int i = 0; i < ctx->original_element_count; i++) {
+        if (!krb_get_element(doc, (uint16_t)i) || !doc->animation_refs) break;
+        if (!bind_refs(engine, &ctx->elements[i], doc->animation_refs[i], doc->elements[i].animation_count, debug_file)) {
+            return false;
+        }
+    }
+    // Instances are laid out in template order starting at their root
+    for (ComponentInstance* inst = ctx->instances; inst; inst = inst->next) {
+        if (!inst->root || inst->definition_index >= doc->header.component_def_count) continue;
+        const KrbComponentDefinition* def = &doc->component_defs[inst->definition_index];
+        for (uint16_t t = 0; t < def->template_element_count; t++) {
+            const KrbTemplateElement* te = &def->template_elements[t];
+            if (!bind_refs(engine, inst->root + t, te->animation_refs, te->header.animation_count, debug_file)) {
+                return false;
+            }
+        }
+    }
+
+    if (debug_file) {
+        fprintf(debug_file, "INFO: Bound %d animation refs (%u animations)\n",
+                engine->binding_count, doc->header.animation_count);
+    }
+    trigger_animations(engine, NULL, ANIM_TRIGGER_LOAD, now);
+    return true;
+}
+
+void free_animation_engine(AnimationEngine* engine) {
+    if (!engine) return;
+    free(engine->bindings);
+    free(engine->runs);
+    memset(engine, 0, sizeof(AnimationEngine));
+}
+
+// --- Runs ---
+
+bool start_animation(AnimationEngine* engine, RenderElement* element, const KrbAnimation* animation, double now) {
+    if (!engine || !element || !animation) return false;
+    for (int i = 0; i < engine->run_count; i++) {
+        if (engine->runs[i].element == element && engine->runs[i].animation == animation) {
+            engine->runs[i].start_time = now;
+            return true;
+        }
+    }
+    if (engine->run_count == engine->run_capacity) {
+        int capacity = engine->run_capacity ? engine->run_capacity * 2 : 16;
+        AnimationRun* grown = realloc(engine->runs, capacity * sizeof(AnimationRun));
+        if (!grown) {
+            perror("realloc animation runs");
+            return false;
+        }
+        engine->runs = grown;
+        engine->run_capacity = capacity;
+    }
+    bool affects_layout = false;
+    for (uint8_t t = 0; t < animation->track_count; t++) {
+        if (!property_is_paint_only(animation->tracks[t].property_id)) affects_layout = true;
+    }
+    engine->runs[engine->run_count++] = (AnimationRun){ element, animation, now, affects_layout };
+    return true;
+}
+
+void trigger_animations(AnimationEngine* engine, RenderElement* element, uint8_t trigger, double now) {
+    if (!engine) return;
+    for (int i = 0; i < engine->binding_count; i++) {
+        AnimationBinding* b = &engine->bindings[i];
+        if (b->trigger == trigger && (!element || b->element == element)) {
+            start_animation(engine, b->element, b->animation, now);
+        }
+    }
+}
+
+void update_animation_triggers(AnimationEngine* engine, RenderElement* hovered, RenderElement* pressed, double now) {
+    if (!engine) return;
+    for (int i = 0; i < engine->binding_count; i++) {
+        AnimationBinding* b = &engine->bindings[i];
+        if (b->trigger == ANIM_TRIGGER_HOVER) {
+            bool inside = (b->element == hovered);
+            if (inside && !b->pointer_inside) start_animation(engine, b->element, b->animation, now);
+            b->pointer_inside = inside;
+        } else if (b->trigger == ANIM_TRIGGER_PRESS && b->element == pressed) {
+            start_animation(engine, b->element, b->animation, now);
+        }
+    }
+}
+
+uint8_t update_animations(AnimationEngine* engine, double now) {
+    if (!engine) return 0;
+    uint8_t dirty = 0;
+    int i = 0;
+    while (i < engine->run_count) {
+        AnimationRun* run = &engine->runs[i];
+        bool finished;
+        float position = sample_position(run->animation, now - run->start_time, &finished);
+        for (uint8_t t = 0; t < run->animation->track_count; t++) {
+            apply_track(engine->doc, run->element, &run->animation->tracks[t], position);
+        }
+        dirty |= ANIM_DIRTY_PAINT;
+        if (run->affects_layout) {
+            remeasure_subtree(run->element, engine->scale_factor);
+            dirty |= ANIM_DIRTY_LAYOUT;
+        }
+        // Retire by swapping in the last run, keeping active runs contiguous
+        if (finished) engine->runs[i] = engine->runs[--engine->run_count];
+        else i++;
+    }
+    return dirty;
+}
+
+bool animations_running(const AnimationEngine* engine) {
+    return engine && engine->run_count > 0;
+}
@@ -7,16 +7,19 @@ static CustomComponentRegistration custom_handlers[MAX_CUSTOM_COMPONENTS];
 static int handler_count = 0;
 
 const char* get_custom_property_value(RenderElement* element, const char* prop_name, KrbDocument* doc) {
-    if (!element || !prop_name || !doc || !element->custom_properties) return NULL;
+    if (!element || !prop_name || !doc || !element->cold->custom_properties) return NULL;
     
-    for (uint8_t i = 0; i < element->custom_prop_count; i++) {
-        KrbCustomProperty* prop = &element->custom_properties[i];
+    // One hash lookup for the name, then integer compares against each key
+    KrbAtom key = krb_find_atom(doc, prop_name);
+    if (key == KRB_INVALID_ATOM) return NULL;
+    
+    for (uint8_t i = 0; i < element->cold->custom_prop_count; i++) {
+        KrbCustomProperty* prop = &element->cold->custom_properties[i];
         
-        if (prop->key_index < doc->header.string_count && doc->strings[prop->key_index] &&
-            strcmp(doc->strings[prop->key_index], prop_name) == 0) {
+        if (krb_string_atom(doc, prop->key_index) == key) {
             
-            if (prop->value_type == VAL_TYPE_STRING && prop->value_size == 1 && prop->value) {
-                uint8_t value_idx = *(uint8_t*)prop->value;
+            uint16_t value_idx;
+            if (prop->value_type == VAL_TYPE_STRING && krb_read_ref_value(prop->value, prop->value_size, &value_idx)) {
                 if (value_idx < doc->header.string_count && doc->strings[value_idx]) {
                     return doc->strings[value_idx];
                 }
@@ -49,18 +52,25 @@ bool process_custom_components(RenderContext* ctx, FILE* debug_file) {
         fprintf(debug_file, "INFO: Processing custom components...\n");
     }
     
+    // Resolve each registered name to an atom of this document once
+    KrbAtom handler_atoms[MAX_CUSTOM_COMPONENTS];
+    for (int i = 0; i < handler_count; i++) {
+        handler_atoms[i] = krb_find_atom(ctx->doc, custom_handlers[i].component_name);
+    }
+    
     // Process component instances
     ComponentInstance* instance = ctx->instances;
     while (instance) {
         if (instance->root && instance->definition_index < ctx->doc->header.component_def_count) {
             KrbComponentDefinition* comp_def = &ctx->doc->component_defs[instance->definition_index];
+            KrbAtom comp_atom = krb_string_atom(ctx->doc, comp_def->name_index);
             
-            if (comp_def->name_index < ctx->doc->header.string_count && ctx->doc->strings[comp_def->name_index]) {
-                const char* comp_name = ctx->doc->strings[comp_def->name_index];
+            if (comp_atom != KRB_INVALID_ATOM) {
+                const char* comp_name = ctx->doc->strings[comp_atom];
                 
                 // Find matching handler
                 for (int i = 0; i < handler_count; i++) {
-                    if (strcmp(comp_name, custom_handlers[i].component_name) == 0) {
+                    if (handler_atoms[i] == comp_atom) {
                         if (debug_file) {
                             fprintf(debug_file, "  Found handler for component '%s' (Element %d)\n", 
                                     comp_name, instance->root->original_index);
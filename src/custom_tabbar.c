@@ -13,7 +13,7 @@ bool handle_tabbar_component(RenderContext* ctx, RenderElement* element, FILE* d
     }
     
     // Get custom properties from the original placeholder
-    ComponentInstance* instance = element->component_instance;
+    ComponentInstance* instance = element->cold->component_instance;
     if (!instance || !instance->placeholder) {
         if (debug_file) fprintf(debug_file, "  ERROR: No component instance or placeholder found\n");
         return false;
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "draw_list.h"
+
+void clear_draw_list(DrawList* list) {
+    if (list) list->count = 0;
+}
+
+void free_draw_list(DrawList* list) {
+    if (!list) return;
+    free(list->commands);
+    memset(list, 0, sizeof(DrawList));
+}
+
+static DrawCommand* push_command(DrawList* list, DrawCommandType type) {
+    if (!list) return NULL;
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        DrawCommand* grown = realloc(list->commands, capacity * sizeof(DrawCommand));
+        if (!grown) {
+            perror("realloc draw commands");
+            return NULL;
+        }
+        list->commands = grown;
+        list->capacity = capacity;
+    }
+    DrawCommand* cmd = &list->commands[list->count++];
+    memset(cmd, 0, sizeof(DrawCommand));
+    cmd->type = type;
+    return cmd;
+}
+
+bool draw_list_rect(DrawList* list, int x, int y, int w, int h, Color color) {
+    DrawCommand* cmd = push_command(list, DRAW_CMD_RECT);
+    if (!cmd) return false;
+    cmd->rect = (Rectangle){ (float)x, (float)y, (float)w, (float)h };
+    cmd->color = color;
+    return true;
+}
+
+bool draw_list_text(DrawList* list, const char* text, int x, int y, int font_size, Color color) {
+    DrawCommand* cmd = push_command(list, DRAW_CMD_TEXT);
+    if (!cmd) return false;
+    cmd->rect = (Rectangle){ (float)x, (float)y, 0.0f, 0.0f };
+    cmd->color = color;
+    cmd->text.text = text;
+    cmd->text.font_size = font_size;
+    return true;
+}
+
+bool draw_list_texture(DrawList* list, Texture2D texture, Rectangle source, Rectangle dest, Color tint) {
+    DrawCommand* cmd = push_command(list, DRAW_CMD_TEXTURE);
+    if (!cmd) return false;
+    cmd->rect = dest;
+    cmd->color = tint;
+    cmd->texture.texture = texture;
+    cmd->texture.source = source;
+    return true;
+}
+
+bool draw_list_scissor_begin(DrawList* list, int x, int y, int w, int h) {
+    DrawCommand* cmd = push_command(list, DRAW_CMD_SCISSOR_BEGIN);
+    if (!cmd) return false;
+    cmd->rect = (Rectangle){ (float)x, (float)y, (float)w, (float)h };
+    return true;
+}
+
+bool draw_list_scissor_end(DrawList* list) {
+    return push_command(list, DRAW_CMD_SCISSOR_END) != NULL;
+}
+
+static Rectangle intersect_rects(Rectangle a, Rectangle b) {
+    float x0 = a.x > b.x ? a.x : b.x;
+    float y0 = a.y > b.y ? a.y : b.y;
+    float x1 = (a.x + a.width < b.x + b.width) ? a.x + a.width : b.x + b.width;
+    float y1 = (a.y + a.height < b.y + b.height) ? a.y + a.height : b.y + b.height;
+    if (x1 <= x0 || y1 <= y0) return (Rectangle){ x0, y0, 0.0f, 0.0f };
+    return (Rectangle){ x0, y0, x1 - x0, y1 - y0 };
+}
+
+static bool rect_is_empty(Rectangle r) {
+    return r.width <= 0.0f || r.height <= 0.0f;
+}
+
+static void begin_scissor_rect(Rectangle r) {
+    BeginScissorMode((int)r.x, (int)r.y, (int)r.width, (int)r.height);
+}
+
+void replay_draw_list_clipped(const DrawList* list, Rectangle clip) {
+    if (!list || rect_is_empty(clip)) return;
+    // raylib scissors do not nest, so 'active' tracks the effective one
+    Rectangle active = clip;
+    begin_scissor_rect(clip);
+    for (int i = 0; i < list->count; i++) {
+        const DrawCommand* cmd = &list->commands[i];
+        switch (cmd->type) {
+            case DRAW_CMD_RECT:
+                if (!rect_is_empty(intersect_rects(cmd->rect, active))) {
+                    DrawRectangle((int)cmd->rect.x, (int)cmd->rect.y, (int)cmd->rect.width, (int)cmd->rect.height, cmd->color);
+                }
+                break;
+            case DRAW_CMD_TEXT:
+                // Text extents are not recorded; runs are culled through their scissor
+                if (!rect_is_empty(active)) {
+                    DrawText(cmd->text.text, (int)cmd->rect.x, (int)cmd->rect.y, cmd->text.font_size, cmd->color);
+                }
+                break;
+            case DRAW_CMD_TEXTURE:
+                if (!rect_is_empty(intersect_rects(cmd->rect, active))) {
+                    DrawTexturePro(cmd->texture.texture, cmd->texture.source, cmd->rect, (Vector2){ 0.0f, 0.0f }, 0.0f, cmd->color);
+                }
+                break;
+            case DRAW_CMD_SCISSOR_BEGIN:
+                active = intersect_rects(cmd->rect, clip);
+                if (!rect_is_empty(active)) begin_scissor_rect(active);
+                break;
+            case DRAW_CMD_SCISSOR_END:
+                active = clip;
+                begin_scissor_rect(clip);
+                break;
+        }
+    }
+    EndScissorMode();
+}
+
+void replay_draw_list(const DrawList* list) {
+    if (!list) return;
+    for (int i = 0; i < list->count; i++) {
+        const DrawCommand* cmd = &list->commands[i];
+        switch (cmd->type) {
+            case DRAW_CMD_RECT:
+                DrawRectangle((int)cmd->rect.x, (int)cmd->rect.y, (int)cmd->rect.width, (int)cmd->rect.height, cmd->color);
+                break;
+            case DRAW_CMD_TEXT:
+                DrawText(cmd->text.text, (int)cmd->rect.x, (int)cmd->rect.y, cmd->text.font_size, cmd->color);
+                break;
+            case DRAW_CMD_TEXTURE:
+                DrawTexturePro(cmd->texture.texture, cmd->texture.source, cmd->rect, (Vector2){ 0.0f, 0.0f }, 0.0f, cmd->color);
+                break;
+            case DRAW_CMD_SCISSOR_BEGIN:
+                BeginScissorMode((int)cmd->rect.x, (int)cmd->rect.y, (int)cmd->rect.width, (int)cmd->rect.height);
+                break;
+            case DRAW_CMD_SCISSOR_END:
+                EndScissorMode();
+                break;
+        }
+    }
+}
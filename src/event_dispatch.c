@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "event_dispatch.h"
+
+void init_event_dispatcher(EventDispatcher* dispatcher, RenderContext* ctx) {
+    if (!dispatcher) return;
+    memset(dispatcher, 0, sizeof(EventDispatcher));
+    dispatcher->ctx = ctx;
+}
+
+void free_event_dispatcher(EventDispatcher* dispatcher) {
+    if (!dispatcher) return;
+    free(dispatcher->callbacks);
+    free(dispatcher->handlers);
+    memset(dispatcher, 0, sizeof(EventDispatcher));
+}
+
+bool register_event_callback(EventDispatcher* dispatcher, const char* name, KrbEventCallback callback, void* user_data) {
+    if (!dispatcher || !name || !callback) return false;
+    if (dispatcher->callback_count == dispatcher->callback_capacity) {
+        // Handler slots store callback indices as int16_t
+        if (dispatcher->callback_count >= INT16_MAX) return false;
+        int capacity = dispatcher->callback_capacity ? dispatcher->callback_capacity * 2 : 8;
+        EventCallbackEntry* grown = realloc(dispatcher->callbacks, capacity * sizeof(EventCallbackEntry));
+        if (!grown) {
+            perror("realloc event callbacks");
+            return false;
+        }
+        dispatcher->callbacks = grown;
+        dispatcher->callback_capacity = capacity;
+    }
+    dispatcher->callbacks[dispatcher->callback_count++] = (EventCallbackEntry){
+        name, KRB_INVALID_ATOM, callback, user_data
+    };
+    return true;
+}
+
+static void bind_events(EventDispatcher* dispatcher, int element_index, const KrbEventFileEntry* events,
+                        uint8_t count, FILE* debug_file) {
+    KrbDocument* doc = dispatcher->ctx->doc;
+    for (uint8_t e = 0; events && e < count; e++) {
+        uint8_t type = events[e].event_type;
+        if (type == EVENT_TYPE_NONE || type > EVENT_SLOT_COUNT) continue;
+        KrbAtom atom = krb_string_atom(doc, events[e].callback_id);
+
+        int16_t found = -1;
+        for (int c = 0; c < dispatcher->callback_count; c++) {
+            if (atom != KRB_INVALID_ATOM && dispatcher->callbacks[c].atom == atom) {
+                found = (int16_t)c;
+                break;
+            }
+        }
+        if (found < 0) {
+            if (debug_file) {
+                fprintf(debug_file, "WARN: No callback registered for '%s' (element %d, event 0x%02X)\n",
+                        atom != KRB_INVALID_ATOM ? doc->strings[atom] : "?", element_index, type);
+            }
+            continue;
+        }
+        dispatcher->handlers[element_index * EVENT_SLOT_COUNT + (type - 1)] = found;
+    }
+}
+
+bool resolve_event_handlers(EventDispatcher* dispatcher, FILE* debug_file) {
+    if (!dispatcher || !dispatcher->ctx || !dispatcher->ctx->doc) return false;
+    RenderContext* ctx = dispatcher->ctx;
+    KrbDocument* doc = ctx->doc;
+
+    for (int c = 0; c < dispatcher->callback_count; c++) {
+        dispatcher->callbacks[c].atom = krb_find_atom(doc, dispatcher->callbacks[c].name);
+    }
+
+    free(dispatcher->handlers);
+    dispatcher->handler_element_count = ctx->element_count;
+    size_t slots = (size_t)(ctx->element_count ? ctx->element_count : 1) * EVENT_SLOT_COUNT;
+    dispatcher->handlers = malloc(slots * sizeof(int16_t));
+    if (!dispatcher->handlers) {
+        perror("malloc event handlers");
+        dispatcher->handler_element_count = 0;
+        return false;
+    }
+    memset(dispatcher->handlers, 0xFF, slots * sizeof(int16_t)); // -1: no handler
+
+    for (int i = 0; i < ctx->original_element_count; i++) {
+        if (!krb_get_element(doc, (uint16_t)i) || !doc->events) break;
+        bind_events(dispatcher, i, doc->events[i], doc->elements[i].event_count, debug_file);
+    }
+    // Instances are laid out in template order starting at their root
+    for (ComponentInstance* inst = ctx->instances; inst; inst = inst->next) {
+        if (!inst->root || inst->definition_index >= doc->header.component_def_count) continue;
+        const KrbComponentDefinition* def = &doc->component_defs[inst->definition_index];
+        int root_index = (int)(inst->root - ctx->elements);
+        for (uint16_t t = 0; t < def->template_element_count; t++) {
+            const KrbTemplateElement* te = &def->template_elements[t];
+            if (root_index + t >= ctx->element_count) break;
+            bind_events(dispatcher, root_index + t, te->events, te->header.event_count, debug_file);
+        }
+    }
+    return true;
+}
+
+bool dispatch_event(EventDispatcher* dispatcher, RenderElement* element, uint8_t event_type) {
+    if (!dispatcher || !dispatcher->handlers || !element) return false;
+    if (event_type == EVENT_TYPE_NONE || event_type > EVENT_SLOT_COUNT) return false;
+    ptrdiff_t index = element - dispatcher->ctx->elements;
+    if (index < 0 || index >= dispatcher->handler_element_count) return false;
+
+    int16_t handler = dispatcher->handlers[index * EVENT_SLOT_COUNT + (event_type - 1)];
+    if (handler < 0) return false;
+    const EventCallbackEntry* entry = &dispatcher->callbacks[handler];
+    entry->callback(element, event_type, entry->user_data);
+    return true;
+}
+
+// Pressed and focused elements show their :active and :focus paint
+static void set_state_flag(EventDispatcher* dispatcher, RenderElement* element, uint8_t flag, bool on) {
+    uint8_t state = element->cold->current_state;
+    update_element_state(element, on ? (uint8_t)(state | flag) : (uint8_t)(state & ~flag), dispatcher->ctx, NULL);
+}
+
+void dispatch_pointer_events(EventDispatcher* dispatcher, FILE* debug_file) {
+    if (!dispatcher || !dispatcher->ctx) return;
+    RenderContext* ctx = dispatcher->ctx;
+
+    // This frame's single pointer query: hover paint, the cursor and these events share it
+    layout_tree(ctx, debug_file);
+    RenderElement* previous = ctx->hovered;
+    update_hover_state(ctx);
+    RenderElement* target = ctx->hovered;
+    if (target && target != previous) dispatch_event(dispatcher, target, EVENT_TYPE_HOVER);
+
+    if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
+        if (target != dispatcher->focused) {
+            if (dispatcher->focused) {
+                set_state_flag(dispatcher, dispatcher->focused, STATE_FOCUS, false);
+                dispatch_event(dispatcher, dispatcher->focused, EVENT_TYPE_BLUR);
+            }
+            dispatcher->focused = target;
+            if (target) {
+                set_state_flag(dispatcher, target, STATE_FOCUS, true);
+                dispatch_event(dispatcher, target, EVENT_TYPE_FOCUS);
+            }
+        }
+        dispatcher->pressed = target;
+        if (target) {
+            set_state_flag(dispatcher, target, STATE_ACTIVE, true);
+            dispatch_event(dispatcher, target, EVENT_TYPE_PRESS);
+        }
+    }
+
+    if (IsMouseButtonReleased(MOUSE_BUTTON_LEFT)) {
+        if (dispatcher->pressed) set_state_flag(dispatcher, dispatcher->pressed, STATE_ACTIVE, false);
+        if (target) dispatch_event(dispatcher, target, EVENT_TYPE_RELEASE);
+        if (target && target == dispatcher->pressed) {
+            if (debug_file) fprintf(debug_file, "INFO: Click on element %d\n", target->original_index);
+            dispatch_event(dispatcher, target, EVENT_TYPE_CLICK);
+        }
+        dispatcher->pressed = NULL;
+    }
+}
@@ -0,0 +1,481 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "krb.h"
+
+// Offline optimizer: rewrites a KRB document so it loads and styles with less work.
+//   1. Merge styles with identical property sets and renumber the survivors
+//   2. Fold direct properties that repeat the element's style (styles apply first)
+//   3. Drop unreferenced resources, then unreferenced and duplicate strings
+//   4. Lay elements out in pre-order so each subtree is contiguous
+// The result is written uncompressed with krb_write_document_to_buffer.
+
+typedef struct {
+    size_t styles_merged;
+    size_t properties_folded;
+    size_t resources_dropped;
+    size_t strings_dropped;
+    size_t elements_moved;
+} OptimizeStats;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Average wall time of one full parse, repeated until the measurement is stable enough
+static double time_parse(const uint8_t* data, size_t size) {
+    int runs = 0;
+    double start = now_seconds(), elapsed = 0.0;
+    do {
+        KrbDocument doc = {0};
+        bool ok = krb_read_document_from_buffer(data, size, &doc);
+        krb_free_document(&doc);
+        if (!ok) return -1.0;
+        runs++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < 0.25 && runs < 100000);
+    return elapsed / runs;
+}
+
+static bool properties_equal(const KrbProperty* a, const KrbProperty* b) {
+    return a->property_id == b->property_id && a->value_type == b->value_type && a->size == b->size &&
+           (a->size == 0 || (a->value && b->value && memcmp(a->value, b->value, a->size) == 0));
+}
+
+// --- Styles ---
+
+static uint16_t remap_style_id(const uint16_t* map, uint16_t count, uint16_t style_id) {
+    if (style_id == 0 || style_id > count) return 0;
+    return (uint16_t)(map[style_id - 1] + 1);
+}
+
+// Styles are addressed by position (style_id - 1), so survivors are compacted and renumbered.
+static bool merge_styles(KrbDocument* doc, OptimizeStats* stats) {
+    uint16_t count = doc->header.style_count;
+    if (count == 0) return true;
+    uint16_t* map = calloc(count, sizeof(uint16_t));
+    if (!map) { perror("calloc style map"); return false; }
+
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        const KrbStyle* style = &doc->styles[i];
+        uint16_t match = kept;
+        for (uint16_t k = 0; k < kept && match == kept; k++) {
+            const KrbStyle* other = &doc->styles[k];
+            if (other->property_count != style->property_count) continue;
+            uint8_t j = 0;
+            while (j < style->property_count && properties_equal(&style->properties[j], &other->properties[j])) j++;
+            if (j == style->property_count) match = k;
+        }
+        if (match == kept) {
+            doc->styles[kept] = *style;
+            doc->styles[kept].id = (uint16_t)(kept + 1);
+            kept++;
+        }
+        map[i] = match;
+    }
+
+    for (uint16_t i = 0; i < doc->header.element_count; i++) {
+        doc->elements[i].style_id = remap_style_id(map, count, doc->elements[i].style_id);
+    }
+    for (uint16_t c = 0; c < doc->header.component_def_count; c++) {
+        KrbComponentDefinition* def = &doc->component_defs[c];
+        for (uint16_t t = 0; t < def->template_element_count; t++) {
+            def->template_elements[t].header.style_id = remap_style_id(map, count, def->template_elements[t].header.style_id);
+        }
+        def->root_template_header.style_id = remap_style_id(map, count, def->root_template_header.style_id);
+    }
+
+    stats->styles_merged = count - kept;
+    doc->header.style_count = kept;
+    free(map);
+    return true;
+}
+
+// Drops direct properties whose value the element's style already sets. Only properties
+// that occur once on the element are folded, so ordering between duplicates is preserved.
+static uint8_t fold_properties(KrbDocument* doc, KrbElementHeader* header, KrbProperty** props) {
+    if (header->style_id == 0 || header->style_id > doc->header.style_count || !*props) return 0;
+    const KrbStyle* style = &doc->styles[header->style_id - 1];
+
+    uint8_t kept = 0;
+    for (uint8_t j = 0; j < header->property_count; j++) {
+        const KrbProperty* prop = &(*props)[j];
+        bool redundant = false;
+        for (uint8_t s = 0; s < style->property_count && !redundant; s++) {
+            redundant = properties_equal(prop, &style->properties[s]);
+        }
+        for (uint8_t k = 0; k < header->property_count && redundant; k++) {
+            if (k != j && (*props)[k].property_id == prop->property_id) redundant = false;
+        }
+        if (!redundant) (*props)[kept++] = *prop;
+    }
+    uint8_t folded = header->property_count - kept;
+    header->property_count = kept;
+    return folded;
+}
+
+static bool fold_all_properties(KrbDocument* doc, OptimizeStats* stats) {
+    // Folding compacts property arrays in place, so their lookup indices are rebuilt
+    for (uint16_t i = 0; i < doc->header.element_count; i++) {
+        uint8_t folded = fold_properties(doc, &doc->elements[i], &doc->properties[i]);
+        if (folded > 0 && doc->property_index &&
+            !krb_index_properties(doc, doc->properties[i], doc->elements[i].property_count, &doc->property_index[i])) {
+            return false;
+        }
+        stats->properties_folded += folded;
+    }
+    for (uint16_t c = 0; c < doc->header.component_def_count; c++) {
+        KrbComponentDefinition* def = &doc->component_defs[c];
+        for (uint16_t t = 0; t < def->template_element_count; t++) {
+            KrbTemplateElement* te = &def->template_elements[t];
+            uint8_t folded = fold_properties(doc, &te->header, &te->properties);
+            if (folded > 0 && !krb_index_properties(doc, te->properties, te->header.property_count, &te->property_index)) {
+                return false;
+            }
+            stats->properties_folded += folded;
+        }
+        if (def->template_element_count > 0) def->root_template_header = def->template_elements[0].header;
+    }
+    return true;
+}
+
+// --- String / Resource References ---
+// One walker visits every string and resource index in the document exactly once, either
+// marking it as used or rewriting it through the compaction map.
+
+typedef struct {
+    KrbDocument* doc;
+    bool strings;        // Visiting string indices (otherwise resource indices)
+    bool marking;        // Mark pass (otherwise remap pass)
+    uint16_t count;      // Table size the indices refer to
+    bool* used;
+    uint16_t* map;
+} RefWalk;
+
+static void walk_index(RefWalk* w, uint16_t* index) {
+    if (*index >= w->count) return;
+    if (w->marking) w->used[*index] = true;
+    else *index = w->map[*index];
+}
+
+static void walk_string(RefWalk* w, uint16_t* index) {
+    if (w->strings) walk_index(w, index);
+}
+
+// Property values are usually borrowed from the image, so remapped values are copied first.
+// Compaction never raises an index, so it always fits the value's original 1 or 2 bytes.
+static void walk_value(RefWalk* w, uint8_t value_type, uint8_t size, void** value) {
+    bool wanted = w->strings ? value_type == VAL_TYPE_STRING : value_type == VAL_TYPE_RESOURCE;
+    uint16_t original;
+    if (!wanted || !*value || !krb_read_ref_value(*value, size, &original)) return;
+    uint16_t index = original;
+    walk_index(w, &index);
+    if (!w->marking && index != original) {
+        uint8_t* copy = krb_document_alloc(w->doc, size);
+        if (!copy) return;
+        copy[0] = (uint8_t)(index & 0xFF);
+        if (size == 2) copy[1] = (uint8_t)(index >> 8);
+        *value = copy;
+    }
+}
+
+static void walk_properties(RefWalk* w, KrbProperty* props, uint8_t count) {
+    for (uint8_t j = 0; props && j < count; j++) walk_value(w, props[j].value_type, props[j].size, &props[j].value);
+}
+
+static void walk_element(RefWalk* w, KrbElementHeader* header, KrbProperty* props, KrbCustomProperty* custom,
+                         KrbStatePropertySet* states, KrbEventFileEntry* events) {
+    // The header is packed; walk a local copy of its id rather than a misaligned pointer
+    uint16_t id = header->id;
+    walk_string(w, &id);
+    header->id = id;
+    walk_properties(w, props, header->property_count);
+    for (uint8_t j = 0; custom && j < header->custom_prop_count; j++) {
+        walk_string(w, &custom[j].key_index);
+        walk_value(w, custom[j].value_type, custom[j].value_size, &custom[j].value);
+    }
+    for (uint8_t j = 0; states && j < header->state_prop_count; j++) {
+        walk_properties(w, states[j].properties, states[j].property_count);
+    }
+    for (uint8_t j = 0; events && j < header->event_count; j++) walk_string(w, &events[j].callback_id);
+}
+
+static void walk_document(RefWalk* w) {
+    KrbDocument* doc = w->doc;
+    for (uint16_t i = 0; i < doc->header.element_count; i++) {
+        walk_element(w, &doc->elements[i], doc->properties[i], doc->custom_properties[i],
+                     doc->state_properties[i], doc->events[i]);
+    }
+    for (uint16_t i = 0; i < doc->header.style_count; i++) {
+        walk_string(w, &doc->styles[i].name_index);
+        walk_properties(w, doc->styles[i].properties, doc->styles[i].property_count);
+    }
+    for (uint16_t c = 0; c < doc->header.component_def_count; c++) {
+        KrbComponentDefinition* def = &doc->component_defs[c];
+        walk_string(w, &def->name_index);
+        for (uint8_t j = 0; j < def->property_def_count; j++) {
+            KrbPropertyDefinition* pd = &def->property_defs[j];
+            walk_string(w, &pd->name_index);
+            walk_value(w, pd->value_type_hint, pd->default_value_size, &pd->default_value_data);
+        }
+        for (uint16_t t = 0; t < def->template_element_count; t++) {
+            KrbTemplateElement* te = &def->template_elements[t];
+            walk_element(w, &te->header, te->properties, te->custom_properties, te->state_properties, te->events);
+        }
+        // The root_template_* fields alias template element 0 and are refreshed, not walked
+        if (def->template_element_count > 0) def->root_template_header = def->template_elements[0].header;
+    }
+    // Animation tracks never hold string or resource values (the reader rejects them)
+    for (uint16_t i = 0; i < doc->header.animation_count; i++) walk_string(w, &doc->animations[i].name_index);
+    for (uint16_t i = 0; i < doc->header.script_count; i++) {
+        KrbScript* script = &doc->scripts[i];
+        walk_string(w, &script->name_index);
+        for (uint8_t j = 0; j < script->entry_point_count; j++) walk_string(w, &script->entry_points[j].function_name_index);
+        if (!w->strings && script->storage_format == SCRIPT_STORAGE_EXTERNAL) walk_index(w, &script->resource_index);
+    }
+    // Resources name strings; only visited once resources themselves are compacted
+    if (w->strings) {
+        for (uint16_t i = 0; i < doc->header.resource_count; i++) {
+            KrbResource* res = &doc->resources[i];
+            walk_string(w, &res->name_index);
+            if (res->format == RES_FORMAT_EXTERNAL) walk_string(w, &res->data_string_index);
+        }
+    }
+}
+
+static bool strip_resources(KrbDocument* doc, OptimizeStats* stats) {
+    uint16_t count = doc->header.resource_count;
+    if (count == 0) return true;
+    RefWalk w = { doc, false, true, count, calloc(count, sizeof(bool)), calloc(count, sizeof(uint16_t)) };
+    if (!w.used || !w.map) { perror("calloc resource map"); free(w.used); free(w.map); return false; }
+
+    walk_document(&w);
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        if (!w.used[i]) continue;
+        w.map[i] = kept;
+        doc->resources[kept++] = doc->resources[i];
+    }
+    w.marking = false;
+    walk_document(&w);
+
+    stats->resources_dropped = count - kept;
+    doc->header.resource_count = kept;
+    free(w.used);
+    free(w.map);
+    return true;
+}
+
+// String 0 is always kept in place: index 0 doubles as "no name" for element ids.
+static bool strip_strings(KrbDocument* doc, OptimizeStats* stats) {
+    uint16_t count = doc->header.string_count;
+    if (count == 0) return true;
+    RefWalk w = { doc, true, true, count, calloc(count, sizeof(bool)), calloc(count, sizeof(uint16_t)) };
+    if (!w.used || !w.map) { perror("calloc string map"); free(w.used); free(w.map); return false; }
+
+    walk_document(&w);
+    w.used[0] = true;
+    // Identical strings share an atom and collapse onto its first surviving copy
+    uint16_t* placed = malloc((size_t)count * sizeof(uint16_t));
+    if (!placed) { perror("malloc string map"); free(w.used); free(w.map); return false; }
+    memset(placed, 0xFF, (size_t)count * sizeof(uint16_t));
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        if (!w.used[i]) continue;
+        KrbAtom atom = krb_string_atom(doc, i);
+        if (atom == KRB_INVALID_ATOM) atom = i;
+        if (placed[atom] == KRB_INVALID_INDEX) {
+            placed[atom] = kept;
+            doc->strings[kept++] = doc->strings[i];
+        }
+        w.map[i] = placed[atom];
+    }
+    free(placed);
+    w.marking = false;
+    walk_document(&w);
+
+    // The interning index describes the old table; nothing after this pass needs atoms
+    doc->string_atoms = NULL;
+    doc->string_hashes = NULL;
+    doc->string_slots = NULL;
+
+    stats->strings_dropped = count - kept;
+    doc->header.string_count = kept;
+    free(w.used);
+    free(w.map);
+    return true;
+}
+
+// --- Element Order ---
+
+#define PERMUTE(type, array) do { \
+        if (!(array)) break; \
+        type* permuted = krb_document_alloc(doc, (size_t)count * sizeof(type)); \
+        if (!permuted) goto fail; \
+        for (uint16_t n = 0; n < count; n++) permuted[n] = (array)[order[n]]; \
+        (array) = permuted; \
+    } while (0)
+
+static uint16_t remap_link(const uint16_t* inverse, uint16_t index) {
+    return index == KRB_INVALID_INDEX ? KRB_INVALID_INDEX : inverse[index];
+}
+
+static bool reorder_preorder(KrbDocument* doc, OptimizeStats* stats) {
+    uint16_t count = doc->header.element_count;
+    if (count == 0 || !doc->element_parent) return true;
+    uint16_t* order = malloc((size_t)count * sizeof(uint16_t));   // new position -> old index
+    uint16_t* inverse = malloc((size_t)count * sizeof(uint16_t)); // old index -> new position
+    uint16_t* stack = malloc((size_t)count * sizeof(uint16_t));
+    if (!order || !inverse || !stack) {
+        perror("malloc element order");
+        free(order); free(inverse); free(stack);
+        return false;
+    }
+
+    // Depth-first from each root in index order; children are pushed in reverse so the
+    // first child is visited first.
+    uint16_t placed = 0;
+    for (uint16_t r = 0; r < count; r++) {
+        if (doc->element_parent[r] != KRB_INVALID_INDEX) continue;
+        uint16_t top = 0;
+        stack[top++] = r;
+        while (top > 0 && placed < count) {
+            uint16_t i = stack[--top];
+            order[placed++] = i;
+            uint16_t first = top;
+            for (uint16_t c = doc->element_first_child[i]; c != KRB_INVALID_INDEX && top < count; c = doc->element_next_sibling[c]) {
+                stack[top++] = c;
+            }
+            for (uint16_t a = first, b = top; a + 1 < b; a++, b--) {
+                uint16_t tmp = stack[a]; stack[a] = stack[b - 1]; stack[b - 1] = tmp;
+            }
+        }
+    }
+    free(stack);
+    if (placed != count) {
+        fprintf(stderr, "Error: Element links do not form a forest (%u of %u reachable)\n", placed, count);
+        free(order); free(inverse);
+        return false;
+    }
+    for (uint16_t n = 0; n < count; n++) {
+        inverse[order[n]] = n;
+        if (order[n] != n) stats->elements_moved++;
+    }
+    if (stats->elements_moved == 0) {
+        free(order); free(inverse);
+        return true;
+    }
+
+    PERMUTE(KrbElementHeader, doc->elements);
+    PERMUTE(uint32_t, doc->element_offsets);
+    PERMUTE(bool, doc->element_decoded);
+    PERMUTE(KrbProperty*, doc->properties);
+    PERMUTE(KrbPropertyIndex, doc->property_index);
+    PERMUTE(KrbCustomProperty*, doc->custom_properties);
+    PERMUTE(KrbStatePropertySet*, doc->state_properties);
+    PERMUTE(KrbEventFileEntry*, doc->events);
+    PERMUTE(KrbAnimationRef*, doc->animation_refs);
+    PERMUTE(uint16_t, doc->element_parent);
+    PERMUTE(uint16_t, doc->element_first_child);
+    PERMUTE(uint16_t, doc->element_next_sibling);
+    for (uint16_t n = 0; n < count; n++) {
+        doc->element_parent[n] = remap_link(inverse, doc->element_parent[n]);
+        doc->element_first_child[n] = remap_link(inverse, doc->element_first_child[n]);
+        doc->element_next_sibling[n] = remap_link(inverse, doc->element_next_sibling[n]);
+    }
+    free(order); free(inverse);
+    return true;
+
+fail:
+    fprintf(stderr, "Error: Out of memory reordering elements\n");
+    free(order); free(inverse);
+    return false;
+}
+
+#undef PERMUTE
+
+// --- Driver ---
+
+static bool optimize_document(KrbDocument* doc, OptimizeStats* stats) {
+    // Every pass works on decoded bodies
+    for (uint16_t i = 0; i < doc->header.element_count; i++) {
+        if (!krb_get_element(doc, i)) return false;
+    }
+    if (!merge_styles(doc, stats)) return false;
+    if (!fold_all_properties(doc, stats)) return false;
+    if (!strip_resources(doc, stats)) return false;
+    if (!strip_strings(doc, stats)) return false;
+    return reorder_preorder(doc, stats);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        printf("Usage: %s <input.krb> <output.krb>\n", argv[0]);
+        return 1;
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) { perror(argv[1]); return 1; }
+    KrbDocument doc = {0};
+    bool ok = krb_read_document(in, &doc);
+    fclose(in);
+    if (!ok) {
+        fprintf(stderr, "ERROR: Failed to parse KRB '%s'\n", argv[1]);
+        krb_free_document(&doc);
+        return 1;
+    }
+
+    uint16_t styles_before = doc.header.style_count;
+    uint16_t strings_before = doc.header.string_count;
+    uint16_t resources_before = doc.header.resource_count;
+    double parse_before = time_parse(doc.data, doc.data_size);
+    size_t size_before = doc.data_size;
+
+    OptimizeStats stats = {0};
+    uint8_t* out_data = NULL;
+    size_t out_size = 0;
+    if (!optimize_document(&doc, &stats) || !krb_write_document_to_buffer(&doc, &out_data, &out_size)) {
+        fprintf(stderr, "ERROR: Failed to optimize '%s'\n", argv[1]);
+        krb_free_document(&doc);
+        return 1;
+    }
+
+    // Re-parse before writing so a broken result never reaches disk
+    double parse_after = time_parse(out_data, out_size);
+    if (parse_after < 0.0) {
+        fprintf(stderr, "ERROR: Optimized document failed to parse; not writing '%s'\n", argv[2]);
+        free(out_data);
+        krb_free_document(&doc);
+        return 1;
+    }
+
+    FILE* out = fopen(argv[2], "wb");
+    if (!out) {
+        perror(argv[2]);
+        free(out_data);
+        krb_free_document(&doc);
+        return 1;
+    }
+    ok = fwrite(out_data, 1, out_size, out) == out_size;
+    if (fclose(out) != 0) ok = false;
+    if (!ok) perror(argv[2]);
+
+    printf("%s -> %s\n", argv[1], argv[2]);
+    printf("  styles:     %u -> %u (%zu merged)\n", styles_before, doc.header.style_count, stats.styles_merged);
+    printf("  properties: %zu folded into styles\n", stats.properties_folded);
+    printf("  strings:    %u -> %u\n", strings_before, doc.header.string_count);
+    printf("  resources:  %u -> %u\n", resources_before, doc.header.resource_count);
+    printf("  elements:   %zu moved into pre-order\n", stats.elements_moved);
+    printf("  size:       %zu -> %zu bytes (%+.1f%%)\n", size_before, out_size,
+           size_before ? 100.0 * ((double)out_size - (double)size_before) / (double)size_before : 0.0);
+    printf("  parse:      %.2f -> %.2f us\n", parse_before * 1e6, parse_after * 1e6);
+
+    free(out_data);
+    krb_free_document(&doc);
+    return ok ? 0 : 1;
+}
@@ -1,10 +1,28 @@
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <errno.h>
 #include <stdbool.h>
 #include "krb.h"
 
+#ifndef KRB_NO_THREADS
+#include <pthread.h>
+#endif
+
+#ifdef KRB_NO_STDIO
+// Embedded builds parse from buffers only and stay silent on malformed input
+static inline void krb_discard_error(const char* fmt, ...) { (void)fmt; }
+#define KRB_ERROR(...) krb_discard_error(__VA_ARGS__)
+#define KRB_PERROR(msg) krb_discard_error(msg)
+#else
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define KRB_ERROR(...) fprintf(stderr, __VA_ARGS__)
+#define KRB_PERROR(msg) perror(msg)
+#endif
+
 // --- Helper Functions ---
 
 // Read little-endian uint16_t
@@ -18,24 +36,133 @@ uint16_t krb_read_u16_le(const void* data) {
 uint32_t krb_read_u32_le(const void* data) {
     if (!data) return 0;
     const unsigned char* p = (const unsigned char*)data;
-    return (uint32_t)(p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24));
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 
-// --- Internal Read Helpers ---
-static bool read_header_internal(FILE* file, KrbHeader* header) {
-    unsigned char buffer[54];
-    if (!file || !header) return false;
-    if (fseek(file, 0, SEEK_SET) != 0) {
-        perror("Error seeking to start of file"); 
-        return false;
+// String and resource refs in values are one byte, or two once the table outgrows 256 entries
+bool krb_read_ref_value(const void* value, uint8_t size, uint16_t* out_index) {
+    if (!value || !out_index) return false;
+    if (size == 1) *out_index = *(const uint8_t*)value;
+    else if (size == 2) *out_index = krb_read_u16_le(value);
+    else return false;
+    return true;
+}
+
+// --- Document Arena ---
+// Every array and copied value of a parsed document is bump-allocated from a short
+// chain of blocks. The first block is sized from the header up front, so a typical
+// document lives in one contiguous allocation and krb_free_document() is O(blocks).
+
+#define KRB_ARENA_ALIGN 16
+#define KRB_ARENA_MIN_BLOCK 4096
+
+struct KrbArenaBlock {
+    struct KrbArenaBlock* next;
+    size_t capacity;
+    size_t used;
+};
+
+// Block payload starts after the header, rounded up to the arena alignment
+#define KRB_ARENA_HEADER_SIZE ((sizeof(struct KrbArenaBlock) + KRB_ARENA_ALIGN - 1) & ~(size_t)(KRB_ARENA_ALIGN - 1))
+
+static KrbArenaBlock* arena_new_block(size_t capacity) {
+    if (capacity < KRB_ARENA_MIN_BLOCK) capacity = KRB_ARENA_MIN_BLOCK;
+    // calloc hands back zeroed pages, so arena allocations need no memset
+    KrbArenaBlock* block = calloc(1, KRB_ARENA_HEADER_SIZE + capacity);
+    if (!block) return NULL;
+    block->capacity = capacity;
+    return block;
+}
+
+// Allocates zeroed memory owned by the document's arena.
+void* krb_document_alloc(KrbDocument* doc, size_t size) {
+    if (!doc) return NULL;
+    if (size == 0) size = 1;
+    size_t aligned = (size + KRB_ARENA_ALIGN - 1) & ~(size_t)(KRB_ARENA_ALIGN - 1);
+
+    KrbArenaBlock* block = doc->arena;
+    if (!block || block->capacity - block->used < aligned) {
+        // Overflow blocks are at least half the size of the current one to keep the chain short
+        size_t capacity = block ? block->capacity / 2 : 0;
+        if (capacity < aligned) capacity = aligned;
+        KrbArenaBlock* fresh = arena_new_block(capacity);
+        if (!fresh) {
+            KRB_PERROR("alloc KRB arena block");
+            return NULL;
+        }
+        fresh->next = block;
+        doc->arena = fresh;
+        block = fresh;
+    }
+    void* p = (uint8_t*)block + KRB_ARENA_HEADER_SIZE + block->used;
+    block->used += aligned;
+    return p;
+}
+
+static void* arena_calloc(KrbDocument* doc, size_t count, size_t size) {
+    if (count != 0 && size > SIZE_MAX / count) return NULL;
+    return krb_document_alloc(doc, count * size);
+}
+
+// Returns the byte span of the section at 'offset', bounded by the next section or end of data
+static size_t section_span_internal(const KrbHeader* h, uint32_t offset, size_t data_size) {
+    if (offset == 0 || offset >= data_size) return 0;
+    const uint32_t offsets[] = { h->element_offset, h->style_offset, h->component_def_offset,
+                                 h->animation_offset, h->script_offset, h->string_offset,
+                                 h->resource_offset };
+    size_t end = data_size;
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        if (offsets[i] > offset && offsets[i] < end) end = offsets[i];
     }
-    size_t bytes_read = fread(buffer, 1, sizeof(buffer), file);
-    if (bytes_read < sizeof(buffer)) {
-        fprintf(stderr, "Error: Failed to read %zu-byte header, got %zu bytes\n", sizeof(buffer), bytes_read);
+    return end - offset;
+}
+
+// Upper-bound estimate of the parsed footprint, from header counts and section sizes.
+// Every property costs at least 3 bytes on disk, which bounds the number of KrbProperty
+// slots a section can produce. Values are borrowed from the buffer and cost nothing.
+static size_t arena_estimate_internal(const KrbHeader* h, size_t data_size) {
+    size_t element_span = section_span_internal(h, h->element_offset, data_size);
+    size_t style_span = section_span_internal(h, h->style_offset, data_size);
+    size_t component_span = section_span_internal(h, h->component_def_offset, data_size);
+    size_t animation_span = section_span_internal(h, h->animation_offset, data_size);
+    size_t string_span = section_span_internal(h, h->string_offset, data_size);
+
+    size_t estimate = 0;
+    estimate += (size_t)h->element_count * (sizeof(KrbElementHeader) + sizeof(KrbProperty*) + sizeof(KrbPropertyIndex) +
+                sizeof(KrbCustomProperty*) + sizeof(KrbStatePropertySet*) + sizeof(KrbEventFileEntry*) +
+                sizeof(KrbAnimationRef*));
+    estimate += (size_t)h->style_count * sizeof(KrbStyle);
+    estimate += (size_t)h->component_def_count * sizeof(KrbComponentDefinition);
+    estimate += (size_t)h->script_count * sizeof(KrbScript);
+    // Animations: a track costs 4+ bytes on disk and a keyframe 1+, so neither outgrows this
+    estimate += (size_t)h->animation_count * sizeof(KrbAnimation) + animation_span * sizeof(KrbKeyframe);
+    estimate += (size_t)h->resource_count * sizeof(KrbResource);
+    // Strings: pointer, atom and hash per entry plus up to four hash slots each
+    estimate += (size_t)h->string_count * (sizeof(char*) + sizeof(uint16_t) + sizeof(uint32_t) +
+                4 * sizeof(uint16_t)) + string_span;
+    // Each property also costs at most one byte of property-index slots. Decoded events (4 bytes
+    // from 2-3 on disk) take less per file byte than properties, so this covers them too.
+    estimate += (element_span + style_span + component_span) / 3 * (sizeof(KrbProperty) + 1);
+    // Per-allocation alignment slack
+    estimate += ((size_t)h->element_count * 6 + h->style_count * 2 + h->component_def_count * 2 +
+                 h->script_count * 2 + h->animation_count + animation_span / 4 + 8) * KRB_ARENA_ALIGN;
+    return estimate;
+}
+
+// Reserves the first arena block once the header is known
+static bool arena_reserve_internal(KrbDocument* doc, size_t data_size) {
+    doc->arena = arena_new_block(arena_estimate_internal(&doc->header, data_size));
+    if (!doc->arena) {
+        KRB_PERROR("alloc KRB arena");
         return false;
     }
+    return true;
+}
 
-    // Parse ALL fields correctly from the buffer according to KRB v0.5 spec
+// --- Internal Read Helpers ---
+
+// Decodes the 54-byte header (unchanged between v0.5 and v0.6) from raw bytes and validates the magic number
+static bool decode_header_internal(const unsigned char* buffer, KrbHeader* header) {
     memcpy(header->magic, buffer + 0, 4);
     header->version = krb_read_u16_le(buffer + 4);
     header->flags = krb_read_u16_le(buffer + 6);
@@ -59,850 +186,1342 @@ static bool read_header_internal(FILE* file, KrbHeader* header) {
 
     // Validate magic number
     if (memcmp(header->magic, "KRB1", 4) != 0) {
-        fprintf(stderr, "Error: Invalid magic number in KRB header\n");
+        KRB_ERROR("Error: Invalid magic number in KRB header\n");
         return false;
     }
-
-    printf("DEBUG: Read offsets from file:\n");
-    printf("  element_offset = %u\n", header->element_offset);
-    printf("  style_offset = %u\n", header->style_offset);
-    printf("  string_offset = %u\n", header->string_offset);
-    printf("  resource_offset = %u\n", header->resource_offset);
-
     return true;
 }
 
-// Reads element header (18 bytes for v0.5)
-static bool read_element_header_internal(FILE* file, KrbElementHeader* element) {
-    if (!file || !element) {
-        fprintf(stderr, "Error: NULL file or element pointer passed to read_element_header_internal.\n");
-        return false;
-    }
+// --- Buffer Parsing ---
+// Every entry point ends up here. Property values, custom property values, default
+// values and inline script code point straight into the backing buffer, so the buffer
+// must stay alive (and unmodified) until krb_free_document().
 
-    size_t expected_size = sizeof(KrbElementHeader);
-    if (expected_size != 18) {
-        fprintf(stderr, "Error: KrbElementHeader size mismatch! Expected 18, got %zu. Check krb.h definition and packing.\n", expected_size);
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+} KrbCursor;
+
+static bool cursor_seek(KrbCursor* cur, size_t offset) {
+    if (offset > cur->size) {
+        KRB_ERROR("Error: Offset %zu is past end of buffer (%zu bytes)\n", offset, cur->size);
         return false;
     }
+    cur->pos = offset;
+    return true;
+}
 
-    size_t bytes_read = fread(element, 1, expected_size, file);
-    if (bytes_read != expected_size) {
-        fprintf(stderr, "Error: Failed to read %zu bytes for element header, got %zu.\n", expected_size, bytes_read);
-        if (feof(file)) { fprintf(stderr, "  (End of file reached prematurely)\n"); }
-        else if (ferror(file)) { perror("  (File read error)"); }
-        return false;
+// Returns a pointer to the next 'count' bytes and advances, or NULL if the buffer is too short
+static const uint8_t* cursor_take(KrbCursor* cur, size_t count) {
+    if (count > cur->size - cur->pos) {
+        KRB_ERROR("Error: Truncated data, need %zu bytes @ %zu (buffer is %zu bytes)\n", count, cur->pos, cur->size);
+        return NULL;
     }
+    const uint8_t* p = cur->data + cur->pos;
+    cur->pos += count;
+    return p;
+}
 
-    // Correct endianness for multi-byte fields
-    element->pos_x = krb_read_u16_le(&element->pos_x);
-    element->pos_y = krb_read_u16_le(&element->pos_y);
-    element->width = krb_read_u16_le(&element->width);
-    element->height = krb_read_u16_le(&element->height);
+// v0.6 files store string, style and child indices in two bytes (see "Wide Indices" in krb.h)
+static bool header_has_wide_indices(const KrbHeader* h) {
+    return (h->version >> 8) >= KRB_WIDE_INDEX_MINOR;
+}
 
+// Reads a one-byte (v0.5) or two-byte (v0.6) index
+static bool cursor_read_index(KrbCursor* cur, bool wide, uint16_t* out) {
+    const uint8_t* p = cursor_take(cur, wide ? 2 : 1);
+    if (!p) return false;
+    *out = wide ? krb_read_u16_le(p) : p[0];
     return true;
 }
 
-// Reads a single standard property
-static bool read_property_internal(FILE* file, KrbProperty* prop) {
-    unsigned char buffer[3]; // ID(1)+Type(1)+Size(1)
-    long prop_header_offset = ftell(file);
-    if (fread(buffer, 1, 3, file) != 3) {
-        fprintf(stderr, "Error: Failed reading property header @ %ld\n", prop_header_offset);
-        prop->value = NULL; 
-        prop->size = 0; 
-        return false;
+// Unsigned LEB128, at most 32 bits
+static bool cursor_read_varint(KrbCursor* cur, uint32_t* out) {
+    uint32_t value = 0;
+    for (unsigned shift = 0; shift < 32; shift += 7) {
+        const uint8_t* p = cursor_take(cur, 1);
+        if (!p) return false;
+        value |= (uint32_t)(*p & 0x7F) << shift;
+        if (!(*p & 0x80)) {
+            *out = value;
+            return true;
+        }
     }
-    prop->property_id = buffer[0]; 
-    prop->value_type = buffer[1]; 
-    prop->size = buffer[2];
+    KRB_ERROR("Error: Varint longer than 32 bits @ %zu\n", cur->pos);
+    return false;
+}
+
+static size_t element_header_size(bool wide) {
+    return wide ? 21 : 18;
+}
+
+static size_t event_entry_size(bool wide) {
+    return wide ? 3 : 2;
+}
+
+static bool cursor_read_element_header(KrbCursor* cur, bool wide, KrbElementHeader* element) {
+    const uint8_t* p = cursor_take(cur, element_header_size(wide));
+    if (!p) return false;
+    // v0.6 widens id, style id and child count; 'w' shifts every later field
+    size_t w = wide ? 1 : 0;
+    element->type = p[0];
+    element->id = wide ? krb_read_u16_le(p + 1) : p[1];
+    element->pos_x = krb_read_u16_le(p + 2 + w);
+    element->pos_y = krb_read_u16_le(p + 4 + w);
+    element->width = krb_read_u16_le(p + 6 + w);
+    element->height = krb_read_u16_le(p + 8 + w);
+    element->layout = p[10 + w];
+    element->style_id = wide ? krb_read_u16_le(p + 12) : p[11];
+    w *= 2;
+    element->property_count = p[12 + w];
+    element->child_count = wide ? krb_read_u16_le(p + 15) : p[13];
+    w = wide ? 3 : 0;
+    element->event_count = p[14 + w];
+    element->animation_count = p[15 + w];
+    element->custom_prop_count = p[16 + w];
+    element->state_prop_count = p[17 + w];
+    return true;
+}
+
+static bool cursor_read_property(KrbCursor* cur, KrbProperty* prop) {
+    const uint8_t* p = cursor_take(cur, 3); // ID(1)+Type(1)+Size(1)
+    if (!p) return false;
+    prop->property_id = p[0];
+    prop->value_type = p[1];
+    prop->size = p[2];
     prop->value = NULL;
-    
     if (prop->size > 0) {
-        prop->value = malloc(prop->size);
-        if (!prop->value) { 
-            perror("malloc prop value"); 
-            return false; 
-        }
-        if (fread(prop->value, 1, prop->size, file) != prop->size) {
-            fprintf(stderr, "Error: Failed reading %u bytes prop value (ID 0x%02X) @ %ld\n", 
-                    prop->size, prop->property_id, ftell(file) - prop->size);
-            free(prop->value); 
-            prop->value = NULL; 
-            return false;
-        }
+        const uint8_t* value = cursor_take(cur, prop->size);
+        if (!value) return false;
+        prop->value = (void*)value;
     }
     return true;
 }
 
-// Reads a single custom property
-static bool read_custom_property_internal(FILE* file, KrbCustomProperty* custom_prop) {
-    unsigned char buffer[3]; // KeyIndex(1)+Type(1)+Size(1)
-    long prop_header_offset = ftell(file);
-    if (fread(buffer, 1, 3, file) != 3) {
-        fprintf(stderr, "Error: Failed reading custom property header @ %ld\n", prop_header_offset);
-        custom_prop->value = NULL; 
-        custom_prop->value_size = 0; 
-        return false;
-    }
-    custom_prop->key_index = buffer[0]; 
-    custom_prop->value_type = buffer[1]; 
-    custom_prop->value_size = buffer[2];
+static bool cursor_read_custom_property(KrbCursor* cur, bool wide, KrbCustomProperty* custom_prop) {
+    if (!cursor_read_index(cur, wide, &custom_prop->key_index)) return false;
+    const uint8_t* p = cursor_take(cur, 2); // Type(1)+Size(1)
+    if (!p) return false;
+    custom_prop->value_type = p[0];
+    custom_prop->value_size = p[1];
     custom_prop->value = NULL;
-    
     if (custom_prop->value_size > 0) {
-        custom_prop->value = malloc(custom_prop->value_size);
-        if (!custom_prop->value) { 
-            perror("malloc custom prop value"); 
-            return false; 
-        }
-        if (fread(custom_prop->value, 1, custom_prop->value_size, file) != custom_prop->value_size) {
-            fprintf(stderr, "Error: Failed reading %u bytes custom prop value (KeyIdx %u) @ %ld\n", 
-                    custom_prop->value_size, custom_prop->key_index, ftell(file) - custom_prop->value_size);
-            free(custom_prop->value); 
-            custom_prop->value = NULL; 
-            return false;
-        }
+        const uint8_t* value = cursor_take(cur, custom_prop->value_size);
+        if (!value) return false;
+        custom_prop->value = (void*)value;
     }
     return true;
 }
 
-// NEW: Reads a single state property set
-static bool read_state_property_set_internal(FILE* file, KrbStatePropertySet* state_set) {
-    unsigned char buffer[2]; // StateFlags(1)+PropertyCount(1)
-    long state_header_offset = ftell(file);
-    if (fread(buffer, 1, 2, file) != 2) {
-        fprintf(stderr, "Error: Failed reading state property set header @ %ld\n", state_header_offset);
-        state_set->properties = NULL;
-        state_set->property_count = 0;
-        return false;
-    }
-    
-    state_set->state_flags = buffer[0];
-    state_set->property_count = buffer[1];
+static bool cursor_read_state_property_set(KrbCursor* cur, KrbDocument* doc, KrbStatePropertySet* state_set) {
+    const uint8_t* p = cursor_take(cur, 2); // StateFlags(1)+PropertyCount(1)
+    if (!p) return false;
+    state_set->state_flags = p[0];
+    state_set->property_count = p[1];
     state_set->properties = NULL;
-    
     if (state_set->property_count > 0) {
-        state_set->properties = calloc(state_set->property_count, sizeof(KrbProperty));
-        if (!state_set->properties) {
-            perror("malloc state property set properties");
-            return false;
-        }
-        
-        // Read each property in the state set
+        state_set->properties = arena_calloc(doc, state_set->property_count, sizeof(KrbProperty));
+        if (!state_set->properties) return false;
         for (uint8_t i = 0; i < state_set->property_count; i++) {
-            if (!read_property_internal(file, &state_set->properties[i])) {
-                fprintf(stderr, "Error: Failed reading state property %u in set @ %ld\n", i, state_header_offset);
-                // Clean up already allocated properties
-                for (uint8_t j = 0; j < i; j++) {
-                    if (state_set->properties[j].value) {
-                        free(state_set->properties[j].value);
-                    }
-                }
-                free(state_set->properties);
-                state_set->properties = NULL;
-                return false;
-            }
+            if (!cursor_read_property(cur, &state_set->properties[i])) return false;
         }
     }
-    
     return true;
 }
 
-// NEW: Reads a script function entry
-static bool read_script_function_internal(FILE* file, KrbScriptFunction* func) {
-    if (fread(&func->function_name_index, 1, 1, file) != 1) {
-        fprintf(stderr, "Error: Failed reading script function name index\n");
+static bool cursor_read_script(KrbCursor* cur, KrbDocument* doc, KrbScript* script) {
+    size_t script_header_offset = cur->pos;
+    bool wide = header_has_wide_indices(&doc->header);
+    // LanguageID(1)+NameIndex(1|2)+StorageFormat(1)+EntryPointCount(1)+DataSize(2)
+    const uint8_t* lang = cursor_take(cur, 1);
+    if (!lang || !cursor_read_index(cur, wide, &script->name_index)) return false;
+    const uint8_t* p = cursor_take(cur, 4);
+    if (!p) return false;
+    script->language_id = lang[0];
+    script->storage_format = p[0];
+    script->entry_point_count = p[1];
+    script->data_size = krb_read_u16_le(p + 2);
+    script->entry_points = NULL;
+    script->code_data = NULL;
+    script->resource_index = 0;
+
+    if (script->entry_point_count > 0) {
+        script->entry_points = arena_calloc(doc, script->entry_point_count, sizeof(KrbScriptFunction));
+        if (!script->entry_points) return false;
+        for (uint8_t i = 0; i < script->entry_point_count; i++) {
+            if (!cursor_read_index(cur, wide, &script->entry_points[i].function_name_index)) return false;
+        }
+    }
+
+    if (script->storage_format == SCRIPT_STORAGE_INLINE) {
+        if (script->data_size > 0) {
+            const uint8_t* code = cursor_take(cur, script->data_size);
+            if (!code) return false;
+            script->code_data = (void*)code;
+        }
+    } else if (script->storage_format == SCRIPT_STORAGE_EXTERNAL) {
+        script->resource_index = script->data_size;
+    } else {
+        KRB_ERROR("Error: Unknown script storage format 0x%02X @ %zu\n",
+                script->storage_format, script_header_offset);
         return false;
     }
     return true;
 }
 
-// NEW: Reads a script entry
-static bool read_script_internal(FILE* file, KrbScript* script) {
-    unsigned char buffer[6]; // LanguageID(1)+NameIndex(1)+StorageFormat(1)+EntryPointCount(1)+DataSize(2)
-    long script_header_offset = ftell(file);
-    
-    if (fread(buffer, 1, 6, file) != 6) {
-        fprintf(stderr, "Error: Failed reading script header @ %ld\n", script_header_offset);
+// --- Section Compression ---
+// With FLAG_COMPRESSED every section starts with UncompressedSize(4) + CompressedSize(4),
+// followed by an LZ4 block. A section is inflated into the arena only when the parser
+// reaches it, so sections that are never read are never decompressed.
+
+#define KRB_SECTION_BLOCK_HEADER_SIZE 8
+
+// Decodes one LZ4 block ("sequences" of literals plus back-references). Returns false on
+// any malformed input rather than reading or writing out of bounds.
+static bool lz4_decompress_block(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size) {
+    const uint8_t* ip = src;
+    const uint8_t* const src_end = src + src_size;
+    uint8_t* op = dst;
+    uint8_t* const dst_end = dst + dst_size;
+
+    while (ip < src_end) {
+        uint8_t token = *ip++;
+
+        // Literal run
+        size_t literal_len = token >> 4;
+        if (literal_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= src_end) return false;
+                b = *ip++;
+                literal_len += b;
+            } while (b == 255);
+        }
+        if (literal_len > (size_t)(src_end - ip) || literal_len > (size_t)(dst_end - op)) return false;
+        memcpy(op, ip, literal_len);
+        ip += literal_len;
+        op += literal_len;
+        if (ip == src_end) break; // The last sequence carries literals only
+
+        // Match: Offset(2) then length with the same 15/255 extension scheme, minimum 4
+        if (src_end - ip < 2) return false;
+        size_t offset = krb_read_u16_le(ip);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return false;
+        size_t match_len = token & 0x0F;
+        if (match_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= src_end) return false;
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += 4;
+        if (match_len > (size_t)(dst_end - op)) return false;
+        // Byte-wise copy: matches may overlap their own output (run-length encoding)
+        const uint8_t* match = op - offset;
+        for (size_t i = 0; i < match_len; i++) op[i] = match[i];
+        op += match_len;
+    }
+    return op == dst_end;
+}
+
+// Positions 'out' at the start of the section stored at 'offset' in the image. Plain
+// sections alias the image; compressed ones are inflated into the arena first.
+static bool open_section_internal(KrbDocument* doc, const KrbCursor* image, uint32_t offset, KrbCursor* out) {
+    *out = *image;
+    if (!cursor_seek(out, offset)) return false;
+    if (!(doc->header.flags & FLAG_COMPRESSED)) return true;
+
+    const uint8_t* block = cursor_take(out, KRB_SECTION_BLOCK_HEADER_SIZE);
+    if (!block) return false;
+    uint32_t uncompressed_size = krb_read_u32_le(block);
+    uint32_t compressed_size = krb_read_u32_le(block + 4);
+    const uint8_t* payload = cursor_take(out, compressed_size);
+    if (!payload) return false;
+    // LZ4 cannot expand a block by more than ~255x; anything larger is a corrupt header
+    if (uncompressed_size > (size_t)compressed_size * 255 + 16) {
+        KRB_ERROR("Error: Implausible compressed section @ %u (%u -> %u bytes)\n",
+                  offset, compressed_size, uncompressed_size);
         return false;
     }
-    
-    script->language_id = buffer[0];
-    script->name_index = buffer[1];
-    script->storage_format = buffer[2];
-    script->entry_point_count = buffer[3];
-    script->data_size = krb_read_u16_le(buffer + 4);
-    script->entry_points = NULL;
-    script->code_data = NULL;
-    script->resource_index = 0;
-    
-    // Read entry points
-    if (script->entry_point_count > 0) {
-        script->entry_points = calloc(script->entry_point_count, sizeof(KrbScriptFunction));
-        if (!script->entry_points) {
-            perror("malloc script entry points");
-            return false;
-        }
-        
-        for (uint8_t i = 0; i < script->entry_point_count; i++) {
-            if (!read_script_function_internal(file, &script->entry_points[i])) {
-                fprintf(stderr, "Error: Failed reading script function %u @ %ld\n", i, script_header_offset);
-                free(script->entry_points);
-                script->entry_points = NULL;
+
+    uint8_t* inflated = krb_document_alloc(doc, uncompressed_size);
+    if (!inflated) return false;
+    if (!lz4_decompress_block(payload, compressed_size, inflated, uncompressed_size)) {
+        KRB_ERROR("Error: Corrupt compressed section @ %u (%u -> %u bytes)\n",
+                  offset, compressed_size, uncompressed_size);
+        return false;
+    }
+    doc->compressed_bytes += KRB_SECTION_BLOCK_HEADER_SIZE + (size_t)compressed_size;
+    doc->uncompressed_bytes += uncompressed_size;
+    doc->sections_decompressed++;
+
+    out->data = inflated;
+    out->size = uncompressed_size;
+    out->pos = 0;
+    return true;
+}
+
+// Skips 'count' id(1)+type(1)+size(1)+value property records
+static bool cursor_skip_properties(KrbCursor* cur, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        const uint8_t* p = cursor_take(cur, 3);
+        if (!p || !cursor_take(cur, p[2])) return false;
+    }
+    return true;
+}
+
+// Reads an element header and steps over its body without decoding or allocating anything
+static bool cursor_skim_element(KrbCursor* cur, bool wide, KrbElementHeader* el) {
+    if (!cursor_read_element_header(cur, wide, el)) return false;
+    if (!cursor_skip_properties(cur, el->property_count)) return false;
+    // Custom properties: KeyIndex(1|2)+Type(1)+Size(1)+value
+    for (uint8_t j = 0; j < el->custom_prop_count; j++) {
+        const uint8_t* p = cursor_take(cur, wide ? 4 : 3);
+        if (!p || !cursor_take(cur, p[wide ? 3 : 2])) return false;
+    }
+    for (uint8_t j = 0; j < el->state_prop_count; j++) {
+        const uint8_t* p = cursor_take(cur, 2); // StateFlags(1)+PropertyCount(1)
+        if (!p || !cursor_skip_properties(cur, p[1])) return false;
+    }
+    size_t trailing = (size_t)el->event_count * event_entry_size(wide)
+                    + (size_t)el->animation_count * 2 // Anim Index(1)+Trigger(1)
+                    + (size_t)el->child_count * 2;    // Child Offset(2)
+    return cursor_take(cur, trailing) != NULL;
+}
+
+// Reads the properties, custom properties, state sets, events and animation refs that follow
+// an element header, leaving the cursor at its child refs. Values are borrowed from the buffer.
+static bool cursor_read_element_body(KrbCursor* cur, KrbDocument* doc, const KrbElementHeader* el,
+                                     KrbProperty** out_props, KrbCustomProperty** out_custom,
+                                     KrbStatePropertySet** out_states, KrbEventFileEntry** out_events,
+                                     KrbAnimationRef** out_anim_refs) {
+    if (el->property_count > 0) {
+        KrbProperty* props = arena_calloc(doc, el->property_count, sizeof(KrbProperty));
+        if (!props) return false;
+        for (uint8_t j = 0; j < el->property_count; j++) {
+            if (!cursor_read_property(cur, &props[j])) {
+                KRB_ERROR("Failed reading prop %u\n", j);
                 return false;
             }
         }
+        *out_props = props;
     }
-    
-    // Read script data based on storage format
-    if (script->storage_format == SCRIPT_STORAGE_INLINE) {
-        // Inline script - read code data directly
-        if (script->data_size > 0) {
-            script->code_data = malloc(script->data_size);
-            if (!script->code_data) {
-                perror("malloc script code data");
-                if (script->entry_points) free(script->entry_points);
+    bool wide = header_has_wide_indices(&doc->header);
+    if (el->custom_prop_count > 0) {
+        KrbCustomProperty* custom = arena_calloc(doc, el->custom_prop_count, sizeof(KrbCustomProperty));
+        if (!custom) return false;
+        for (uint8_t j = 0; j < el->custom_prop_count; j++) {
+            if (!cursor_read_custom_property(cur, wide, &custom[j])) {
+                KRB_ERROR("Failed reading custom prop %u\n", j);
                 return false;
             }
-            
-            if (fread(script->code_data, 1, script->data_size, file) != script->data_size) {
-                fprintf(stderr, "Error: Failed reading %u bytes script code data @ %ld\n", 
-                        script->data_size, script_header_offset);
-                free(script->code_data);
-                if (script->entry_points) free(script->entry_points);
+        }
+        *out_custom = custom;
+    }
+    if (el->state_prop_count > 0) {
+        KrbStatePropertySet* states = arena_calloc(doc, el->state_prop_count, sizeof(KrbStatePropertySet));
+        if (!states) return false;
+        for (uint8_t j = 0; j < el->state_prop_count; j++) {
+            if (!cursor_read_state_property_set(cur, doc, &states[j])) {
+                KRB_ERROR("Failed reading state prop set %u\n", j);
                 return false;
             }
         }
-    } else if (script->storage_format == SCRIPT_STORAGE_EXTERNAL) {
-        // External script - data_size field contains resource index
-        script->resource_index = (uint8_t)script->data_size;
-    } else {
-        fprintf(stderr, "Error: Unknown script storage format 0x%02X @ %ld\n", 
-                script->storage_format, script_header_offset);
-        if (script->entry_points) free(script->entry_points);
+        *out_states = states;
+    }
+    if (el->event_count > 0) {
+        size_t entry = event_entry_size(wide);
+        const uint8_t* ev = cursor_take(cur, (size_t)el->event_count * entry);
+        KrbEventFileEntry* events = ev ? arena_calloc(doc, el->event_count, sizeof(KrbEventFileEntry)) : NULL;
+        if (!events) {
+            KRB_ERROR("Error: Failed reading %u events\n", el->event_count);
+            return false;
+        }
+        for (uint8_t j = 0; j < el->event_count; j++, ev += entry) {
+            events[j].event_type = ev[0];
+            events[j].callback_id = wide ? krb_read_u16_le(ev + 1) : ev[1];
+        }
+        *out_events = events;
+    }
+    if (el->animation_count > 0) {
+        const uint8_t* refs = cursor_take(cur, (size_t)el->animation_count * sizeof(KrbAnimationRef));
+        if (!refs) {
+            KRB_ERROR("Error: Failed reading %u animation refs\n", el->animation_count);
+            return false;
+        }
+        // Same for KrbAnimationRef
+        *out_anim_refs = (KrbAnimationRef*)refs;
+    }
+    return true;
+}
+
+// --- Property Index ---
+
+// Builds the presence mask and slot table for one property array. Later occurrences of an
+// id overwrite earlier slots, so lookups see the value that applying in order would leave.
+bool krb_index_properties(KrbDocument* doc, const KrbProperty* props, uint8_t count, KrbPropertyIndex* index) {
+    if (!doc || !index) return false;
+    index->mask = 0;
+    index->slots = NULL;
+    for (uint8_t j = 0; props && j < count; j++) {
+        if (props[j].property_id < KRB_PROPERTY_INDEX_LIMIT) index->mask |= (uint64_t)1 << props[j].property_id;
+    }
+    if (index->mask == 0) return true;
+
+    index->slots = krb_document_alloc(doc, (size_t)__builtin_popcountll(index->mask));
+    if (!index->slots) return false;
+    for (uint8_t j = 0; j < count; j++) {
+        uint8_t id = props[j].property_id;
+        if (id >= KRB_PROPERTY_INDEX_LIMIT) continue;
+        index->slots[__builtin_popcountll(index->mask & (((uint64_t)1 << id) - 1))] = j;
+    }
+    return true;
+}
+
+// Decodes the body of document element 'i'. The skim already bounds-checked it,
+// so only allocation can fail here.
+static bool decode_element_body_internal(KrbDocument* doc, uint16_t i) {
+    if (doc->element_decoded[i]) return true;
+    KrbCursor body = { doc->element_section, doc->element_section_size,
+                       (size_t)doc->element_offsets[i] + element_header_size(header_has_wide_indices(&doc->header)) };
+    if (!cursor_read_element_body(&body, doc, &doc->elements[i], &doc->properties[i], &doc->custom_properties[i],
+                                  &doc->state_properties[i], &doc->events[i], &doc->animation_refs[i])) {
+        KRB_ERROR("Failed decoding elem %u\n", i);
         return false;
     }
-    
+    if (!krb_index_properties(doc, doc->properties[i], doc->elements[i].property_count, &doc->property_index[i])) {
+        return false;
+    }
+    doc->element_decoded[i] = true;
     return true;
 }
 
-// --- Public API Functions ---
+// Finds the element whose header starts at 'offset' ('offsets' is ascending)
+static uint16_t find_element_at_offset(const uint32_t* offsets, uint16_t count, uint32_t offset) {
+    uint16_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint16_t mid = (uint16_t)(lo + (hi - lo) / 2);
+        if (offsets[mid] < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < count && offsets[lo] == offset) ? lo : KRB_INVALID_INDEX;
+}
 
-// Reads the entire KRB document structure into memory.
-bool krb_read_document(FILE* file, KrbDocument* doc) {
-    if (!file || !doc) return false;
-    memset(doc, 0, sizeof(KrbDocument));
+// Appends 'child' to the end of 'parent's child list
+static void link_child_internal(KrbDocument* doc, uint16_t parent, uint16_t child, uint16_t* last_child) {
+    doc->element_parent[child] = parent;
+    if (last_child[parent] == KRB_INVALID_INDEX) doc->element_first_child[parent] = child;
+    else doc->element_next_sibling[last_child[parent]] = child;
+    last_child[parent] = child;
+}
 
-    // Read and validate header
-    if (!read_header_internal(file, &doc->header)) {
+// Resolves every element's child refs (offsets relative to its own header) into parent,
+// first-child and next-sibling indices. Children must follow their parent, as in the
+// pre-order layout the compiler writes, which also rules out cycles. Documents whose refs
+// do not land on element headers fall back to deriving the tree from pre-order child counts.
+static bool link_elements_internal(KrbDocument* doc, size_t section_end) {
+    uint16_t count = doc->header.element_count;
+    doc->element_parent = arena_calloc(doc, count, sizeof(uint16_t));
+    doc->element_first_child = arena_calloc(doc, count, sizeof(uint16_t));
+    doc->element_next_sibling = arena_calloc(doc, count, sizeof(uint16_t));
+    uint16_t* last_child = arena_calloc(doc, count, sizeof(uint16_t));
+    uint16_t* attached = arena_calloc(doc, count, sizeof(uint16_t));
+    if (!doc->element_parent || !doc->element_first_child || !doc->element_next_sibling || !last_child || !attached) {
         return false;
     }
-    // Store parsed version components
-    doc->version_major = (doc->header.version & 0x00FF);
-    doc->version_minor = (doc->header.version >> 8);
-    // Validate App element presence if flag is set
-    if ((doc->header.flags & FLAG_HAS_APP) && doc->header.element_count > 0) {
-        long original_pos = ftell(file);
-        printf("DEBUG: App check - original_pos=%ld, element_offset=%u\n", original_pos, doc->header.element_offset);
-        
-        if (fseek(file, doc->header.element_offset, SEEK_SET) != 0) { 
-            perror("seek App check"); 
-            krb_free_document(doc); 
-            return false; 
-        }
-        
-        long current_pos = ftell(file);
-        printf("DEBUG: App check - after seek, current_pos=%ld\n", current_pos);
-        
-        unsigned char first_type;
-        size_t bytes_read = fread(&first_type, 1, 1, file);
-        if (bytes_read != 1) { 
-            fprintf(stderr, "read App check failed: requested 1 byte, got %zu bytes\n", bytes_read);
-            if (feof(file)) fprintf(stderr, "  - End of file reached\n");
-            if (ferror(file)) fprintf(stderr, "  - File read error\n");
-            perror("  - System error");
-            fseek(file, original_pos, SEEK_SET); 
-            krb_free_document(doc); 
-            return false; 
-        }
-        
-        printf("DEBUG: App check - read first_type=0x%02X\n", first_type);
-        
-        if (first_type != ELEM_TYPE_APP) { 
-            fprintf(stderr, "Error: FLAG_HAS_APP set, but first elem type 0x%02X != 0x00\n", first_type); 
-            fseek(file, original_pos, SEEK_SET); 
-            krb_free_document(doc); 
-            return false; 
-        }
-        if (fseek(file, original_pos, SEEK_SET) != 0) { 
-            perror("seek back App check"); 
-            krb_free_document(doc); 
-            return false; 
-        }
-    }
-    // --- Read Elements, Properties, Custom Properties, State Properties, and Events ---
-    if (doc->header.element_count > 0) {
-        if (doc->header.element_offset == 0) { 
-            fprintf(stderr, "Error: Zero element offset with non-zero count.\n"); 
-            krb_free_document(doc); 
-            return false; 
-        }
-
-        // Allocate memory
-        doc->elements = calloc(doc->header.element_count, sizeof(KrbElementHeader));
-        doc->properties = calloc(doc->header.element_count, sizeof(KrbProperty*));
-        doc->custom_properties = calloc(doc->header.element_count, sizeof(KrbCustomProperty*));
-        doc->state_properties = calloc(doc->header.element_count, sizeof(KrbStatePropertySet*)); // NEW
-        doc->events = calloc(doc->header.element_count, sizeof(KrbEventFileEntry*));
-        
-        if (!doc->elements || !doc->properties || !doc->custom_properties || !doc->state_properties || !doc->events) {
-            perror("calloc elements/props/custom_props/state_props/events ptrs"); 
-            krb_free_document(doc); 
+    memset(doc->element_parent, 0xFF, count * sizeof(uint16_t));
+    memset(doc->element_first_child, 0xFF, count * sizeof(uint16_t));
+    memset(doc->element_next_sibling, 0xFF, count * sizeof(uint16_t));
+    memset(last_child, 0xFF, count * sizeof(uint16_t));
+
+    bool refs_valid = true;
+    for (uint16_t i = 0; i < count && refs_valid; i++) {
+        // Child refs are the last bytes of the element block
+        size_t end = (i + 1 < count) ? doc->element_offsets[i + 1] : section_end;
+        const uint8_t* refs = doc->element_section + end - (size_t)doc->elements[i].child_count * 2;
+        for (uint16_t k = 0; k < doc->elements[i].child_count; k++) {
+            uint32_t target = doc->element_offsets[i] + krb_read_u16_le(refs + 2 * k);
+            uint16_t c = find_element_at_offset(doc->element_offsets, count, target);
+            if (c == KRB_INVALID_INDEX || c <= i || doc->element_parent[c] != KRB_INVALID_INDEX) {
+                refs_valid = false;
+                break;
+            }
+            link_child_internal(doc, i, c, last_child);
+        }
+    }
+    if (refs_valid) return true;
+
+    KRB_ERROR("Warning: Element child refs are invalid; deriving tree from child counts\n");
+    memset(doc->element_parent, 0xFF, count * sizeof(uint16_t));
+    memset(doc->element_first_child, 0xFF, count * sizeof(uint16_t));
+    memset(doc->element_next_sibling, 0xFF, count * sizeof(uint16_t));
+    memset(last_child, 0xFF, count * sizeof(uint16_t));
+    uint16_t open = KRB_INVALID_INDEX; // Innermost element still expecting children
+    for (uint16_t i = 0; i < count; i++) {
+        while (open != KRB_INVALID_INDEX && attached[open] >= doc->elements[open].child_count) {
+            open = doc->element_parent[open];
+        }
+        if (open != KRB_INVALID_INDEX) {
+            link_child_internal(doc, open, i, last_child);
+            attached[open]++;
+        }
+        if (doc->elements[i].child_count > 0) open = i;
+    }
+    return true;
+}
+
+// Parses a component's template: the root element block followed by its descendants in
+// pre-order. Every element is fully decoded and child refs are resolved to parent indices,
+// so instantiation is a straight copy of def->template_elements.
+static bool parse_component_template(KrbCursor* cur, KrbDocument* doc, KrbComponentDefinition* def) {
+    // Pass 1: every element except the root is someone's child, so the subtree ends
+    // when no announced child is left unread.
+    bool wide = header_has_wide_indices(&doc->header);
+    size_t start = cur->pos;
+    uint32_t count = 0;
+    uint32_t pending = 1;
+    while (pending > 0) {
+        KrbElementHeader h;
+        if (!cursor_skim_element(cur, wide, &h)) return false;
+        if (++count >= KRB_INVALID_INDEX) {
+            KRB_ERROR("Error: Component template has too many elements\n");
             return false;
         }
+        pending += h.child_count;
+        pending--;
+    }
 
-        if (fseek(file, doc->header.element_offset, SEEK_SET) != 0) {
-            perror("seek element data"); 
-            krb_free_document(doc); 
+    // Pass 2: decode each element and remember where its child refs are
+    uint16_t n = (uint16_t)count;
+    KrbTemplateElement* elements = arena_calloc(doc, n, sizeof(KrbTemplateElement));
+    uint32_t* offsets = arena_calloc(doc, n, sizeof(uint32_t));
+    const uint8_t** child_refs = arena_calloc(doc, n, sizeof(const uint8_t*));
+    if (!elements || !offsets || !child_refs) return false;
+    cur->pos = start;
+    for (uint16_t t = 0; t < n; t++) {
+        KrbTemplateElement* te = &elements[t];
+        offsets[t] = (uint32_t)(cur->pos - start);
+        te->parent_index = KRB_INVALID_INDEX;
+        if (!cursor_read_element_header(cur, wide, &te->header) ||
+            !cursor_read_element_body(cur, doc, &te->header, &te->properties, &te->custom_properties,
+                                      &te->state_properties, &te->events, &te->animation_refs) ||
+            !krb_index_properties(doc, te->properties, te->header.property_count, &te->property_index)) {
             return false;
         }
+        child_refs[t] = cursor_take(cur, (size_t)te->header.child_count * 2);
+        if (!child_refs[t]) return false;
+    }
 
-        for (uint16_t i = 0; i < doc->header.element_count; i++) {
-            // Read element header
-            if (!read_element_header_internal(file, &doc->elements[i])) {
-                fprintf(stderr, "Failed reading header elem %u\n", i); 
-                krb_free_document(doc); 
+    // Pass 3: child offsets are relative to the parent's header
+    for (uint16_t t = 0; t < n; t++) {
+        for (uint16_t k = 0; k < elements[t].header.child_count; k++) {
+            uint32_t target = offsets[t] + krb_read_u16_le(child_refs[t] + 2 * k);
+            uint16_t c = find_element_at_offset(offsets, n, target);
+            if (c == KRB_INVALID_INDEX || c <= t || elements[c].parent_index != KRB_INVALID_INDEX) {
+                KRB_ERROR("Error: Bad child ref %u of template element %u\n", k, t);
                 return false;
             }
+            elements[c].parent_index = t;
+        }
+    }
+    for (uint16_t t = 1; t < n; t++) {
+        if (elements[t].parent_index == KRB_INVALID_INDEX) {
+            KRB_ERROR("Error: Template element %u is not referenced by any parent\n", t);
+            return false;
+        }
+    }
 
-            // Read standard properties
-            if (doc->elements[i].property_count > 0) {
-                doc->properties[i] = calloc(doc->elements[i].property_count, sizeof(KrbProperty));
-                if (!doc->properties[i]) { 
-                    perror("calloc props elem"); 
-                    fprintf(stderr, "Elem %u\n", i); 
-                    krb_free_document(doc); 
-                    return false; 
-                }
-                for (uint8_t j = 0; j < doc->elements[i].property_count; j++) {
-                    if (!read_property_internal(file, &doc->properties[i][j])) {
-                        fprintf(stderr, "Failed reading prop %u elem %u\n", j, i); 
-                        krb_free_document(doc); 
-                        return false;
-                    }
-                }
-            }
+    def->template_elements = elements;
+    def->template_element_count = n;
+    def->root_template_header = elements[0].header;
+    def->root_template_properties = elements[0].properties;
+    def->root_template_custom_props = elements[0].custom_properties;
+    def->root_template_state_props = elements[0].state_properties;
+    def->root_template_events = elements[0].events;
+    return true;
+}
 
-            // Read custom properties
-            if (doc->elements[i].custom_prop_count > 0) {
-                doc->custom_properties[i] = calloc(doc->elements[i].custom_prop_count, sizeof(KrbCustomProperty));
-                if (!doc->custom_properties[i]) { 
-                    perror("calloc custom props elem"); 
-                    fprintf(stderr, "Elem %u\n", i); 
-                    krb_free_document(doc); 
-                    return false; 
-                }
-                for (uint8_t j = 0; j < doc->elements[i].custom_prop_count; j++) {
-                    if (!read_custom_property_internal(file, &doc->custom_properties[i][j])) {
-                        fprintf(stderr, "Failed reading custom prop %u elem %u\n", j, i); 
-                        krb_free_document(doc); 
-                        return false;
-                    }
-                }
-            }
+// --- String Interning ---
 
-            // NEW: Read state properties
-            if (doc->elements[i].state_prop_count > 0) {
-                doc->state_properties[i] = calloc(doc->elements[i].state_prop_count, sizeof(KrbStatePropertySet));
-                if (!doc->state_properties[i]) {
-                    perror("calloc state props elem");
-                    fprintf(stderr, "Elem %u\n", i);
-                    krb_free_document(doc);
-                    return false;
-                }
-                for (uint8_t j = 0; j < doc->elements[i].state_prop_count; j++) {
-                    if (!read_state_property_set_internal(file, &doc->state_properties[i][j])) {
-                        fprintf(stderr, "Failed reading state prop set %u elem %u\n", j, i);
-                        krb_free_document(doc);
-                        return false;
-                    }
-                }
-            }
+// FNV-1a over the NUL-terminated string (v0.6 lengths are LEB128, so no fixed bound)
+static uint32_t string_hash_internal(const char* str) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)str; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
 
-            // Read Events
-            if (doc->elements[i].event_count > 0) {
-                doc->events[i] = calloc(doc->elements[i].event_count, sizeof(KrbEventFileEntry));
-                if (!doc->events[i]) { 
-                    perror("calloc events elem"); 
-                    fprintf(stderr, "Elem %u\n", i); 
-                    krb_free_document(doc); 
-                    return false; 
-                }
-                size_t events_to_read = doc->elements[i].event_count;
-                size_t events_read = fread(doc->events[i], sizeof(KrbEventFileEntry), events_to_read, file);
-                if (events_read != events_to_read) {
-                    fprintf(stderr, "Error: Read %zu/%zu events elem %u\n", events_read, events_to_read, i); 
-                    krb_free_document(doc); 
-                    return false;
-                }
-            }
+// Builds the atom of every string and the hash index over the distinct ones. The slot
+// count is a power of two at least twice the string count, so probes stay short.
+static bool intern_strings_internal(KrbDocument* doc) {
+    uint16_t count = doc->header.string_count;
+    uint32_t slots = 16;
+    while (slots < 2u * count) slots <<= 1;
+    doc->string_atoms = arena_calloc(doc, count, sizeof(uint16_t));
+    doc->string_hashes = arena_calloc(doc, count, sizeof(uint32_t));
+    doc->string_slots = arena_calloc(doc, slots, sizeof(uint16_t));
+    if (!doc->string_atoms || !doc->string_hashes || !doc->string_slots) return false;
+    memset(doc->string_slots, 0xFF, slots * sizeof(uint16_t));
+    doc->string_slot_mask = slots - 1;
 
-            // Skip Animation Refs and Child Refs
-            long bytes_to_skip = (long)doc->elements[i].animation_count * 2 // Anim Index(1)+Trigger(1)
-                               + (long)doc->elements[i].child_count * 2;   // Child Offset(2)
-            if (bytes_to_skip > 0) {
-                if (fseek(file, bytes_to_skip, SEEK_CUR) != 0) {
-                    perror("seek skip refs"); 
-                    fprintf(stderr, "Elem %u\n", i); 
-                    krb_free_document(doc); 
-                    return false;
-                }
+    for (uint16_t i = 0; i < count; i++) {
+        uint32_t hash = string_hash_internal(doc->strings[i]);
+        doc->string_hashes[i] = hash;
+        uint32_t slot = hash & doc->string_slot_mask;
+        for (;;) {
+            uint16_t atom = doc->string_slots[slot];
+            if (atom == KRB_INVALID_INDEX) {
+                doc->string_slots[slot] = i;
+                doc->string_atoms[i] = i;
+                break;
             }
+            if (doc->string_hashes[atom] == hash && strcmp(doc->strings[atom], doc->strings[i]) == 0) {
+                doc->string_atoms[i] = atom;
+                break;
+            }
+            slot = (slot + 1) & doc->string_slot_mask;
         }
     }
+    return true;
+}
 
-    // --- Read Styles ---
-    if (doc->header.style_count > 0) {
-        if (doc->header.style_offset == 0) { 
-            fprintf(stderr, "Error: Zero style offset with non-zero count.\n"); 
-            krb_free_document(doc); 
-            return false; 
-        }
-        doc->styles = calloc(doc->header.style_count, sizeof(KrbStyle));
-        if (!doc->styles) { 
-            perror("calloc styles"); 
-            krb_free_document(doc); 
-            return false; 
+// --- Section Parsers ---
+// Each parser reads one section and writes only that section's fields of 'doc', so
+// independent sections can be decoded on separate threads (see KRB_LOAD_PARALLEL).
+
+// Elements: a single skim validates every element and records where it starts; bodies are
+// decoded now or, with KRB_LOAD_LAZY_ELEMENTS, on first krb_get_element*() call.
+static bool parse_element_section(KrbDocument* doc, const KrbCursor* image, uint32_t load_flags) {
+    if (doc->header.element_count == 0) return true;
+    uint16_t count = doc->header.element_count;
+    if (doc->header.element_offset == 0) {
+        KRB_ERROR("Error: Zero element offset with non-zero count.\n");
+        return false;
+    }
+    doc->elements = arena_calloc(doc, count, sizeof(KrbElementHeader));
+    doc->element_offsets = arena_calloc(doc, count, sizeof(uint32_t));
+    doc->element_decoded = arena_calloc(doc, count, sizeof(bool));
+    doc->properties = arena_calloc(doc, count, sizeof(KrbProperty*));
+    doc->property_index = arena_calloc(doc, count, sizeof(KrbPropertyIndex));
+    doc->custom_properties = arena_calloc(doc, count, sizeof(KrbCustomProperty*));
+    doc->state_properties = arena_calloc(doc, count, sizeof(KrbStatePropertySet*));
+    doc->events = arena_calloc(doc, count, sizeof(KrbEventFileEntry*));
+    doc->animation_refs = arena_calloc(doc, count, sizeof(KrbAnimationRef*));
+    if (!doc->elements || !doc->element_offsets || !doc->element_decoded || !doc->properties ||
+        !doc->property_index || !doc->custom_properties || !doc->state_properties || !doc->events ||
+        !doc->animation_refs) {
+        return false;
+    }
+    KrbCursor section;
+    if (!open_section_internal(doc, image, doc->header.element_offset, &section)) return false;
+    KrbCursor* cur = &section;
+    bool wide = header_has_wide_indices(&doc->header);
+    doc->element_section = section.data;
+    doc->element_section_size = section.size;
+
+    // Validate App element presence if flag is set
+    if ((doc->header.flags & FLAG_HAS_APP) && cur->pos < cur->size && cur->data[cur->pos] != ELEM_TYPE_APP) {
+        KRB_ERROR("Error: FLAG_HAS_APP set, but first elem type 0x%02X != 0x00\n", cur->data[cur->pos]);
+        return false;
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+        doc->element_offsets[i] = (uint32_t)cur->pos;
+        if (!cursor_skim_element(cur, wide, &doc->elements[i])) {
+            KRB_ERROR("Failed reading elem %u\n", i);
+            return false;
         }
-        if (fseek(file, doc->header.style_offset, SEEK_SET) != 0) { 
-            perror("seek styles"); 
-            krb_free_document(doc); 
-            return false; 
+    }
+    if (!link_elements_internal(doc, cur->pos)) return false;
+    if (!(load_flags & KRB_LOAD_LAZY_ELEMENTS)) {
+        for (uint16_t i = 0; i < count; i++) {
+            if (!decode_element_body_internal(doc, i)) return false;
         }
+    }
+    return true;
+}
 
-        for (uint16_t i = 0; i < doc->header.style_count; i++) {
-            unsigned char style_header_buf[3]; // ID(1)+NameIdx(1)+PropCount(1)
-            if (fread(style_header_buf, 1, 3, file) != 3) { 
-                fprintf(stderr, "Failed read style header %u\n", i); 
-                krb_free_document(doc); 
-                return false; 
-            }
-            doc->styles[i].id = style_header_buf[0]; // 1-based ID
-            doc->styles[i].name_index = style_header_buf[1]; // 0-based index
-            doc->styles[i].property_count = style_header_buf[2];
-            doc->styles[i].properties = NULL;
-
-            if (doc->styles[i].property_count > 0) {
-                doc->styles[i].properties = calloc(doc->styles[i].property_count, sizeof(KrbProperty));
-                if (!doc->styles[i].properties) { 
-                    perror("calloc style props"); 
-                    fprintf(stderr, "Style %u\n", i); 
-                    krb_free_document(doc); 
-                    return false; 
-                }
-                for (uint8_t j = 0; j < doc->styles[i].property_count; j++) {
-                    if (!read_property_internal(file, &doc->styles[i].properties[j])) { 
-                        fprintf(stderr, "Failed read prop %u style %u\n", j, i); 
-                        krb_free_document(doc); 
-                        return false; 
-                    }
+static bool parse_style_section(KrbDocument* doc, const KrbCursor* image, uint32_t load_flags) {
+    (void)load_flags;
+    if (doc->header.style_count == 0) return true;
+    if (doc->header.style_offset == 0) {
+        KRB_ERROR("Error: Zero style offset with non-zero count.\n");
+        return false;
+    }
+    doc->styles = arena_calloc(doc, doc->header.style_count, sizeof(KrbStyle));
+    if (!doc->styles) return false;
+    KrbCursor section;
+    if (!open_section_internal(doc, image, doc->header.style_offset, &section)) return false;
+    KrbCursor* cur = &section;
+    bool wide = header_has_wide_indices(&doc->header);
+
+    for (uint16_t i = 0; i < doc->header.style_count; i++) {
+        KrbStyle* style = &doc->styles[i];
+        const uint8_t* p = NULL; // ID(1|2)+NameIdx(1|2)+PropCount(1)
+        if (!cursor_read_index(cur, wide, &style->id) || !cursor_read_index(cur, wide, &style->name_index) ||
+            !(p = cursor_take(cur, 1))) {
+            KRB_ERROR("Failed read style header %u\n", i);
+            return false;
+        }
+        style->property_count = p[0];
+        style->properties = NULL;
+        if (style->property_count > 0) {
+            style->properties = arena_calloc(doc, style->property_count, sizeof(KrbProperty));
+            if (!style->properties) return false;
+            for (uint8_t j = 0; j < style->property_count; j++) {
+                if (!cursor_read_property(cur, &style->properties[j])) {
+                    KRB_ERROR("Failed read prop %u style %u\n", j, i);
+                    return false;
                 }
             }
         }
+        if (!krb_index_properties(doc, style->properties, style->property_count, &style->property_index)) return false;
     }
+    return true;
+}
 
-    // --- Read Component Definitions ---
-    if (doc->header.component_def_count > 0) {
-        if (doc->header.component_def_offset == 0) { 
-            fprintf(stderr, "Error: Zero component def offset with non-zero count.\n"); 
-            krb_free_document(doc); 
-            return false; 
-        }
-        doc->component_defs = calloc(doc->header.component_def_count, sizeof(KrbComponentDefinition));
-        if (!doc->component_defs) { 
-            perror("calloc component defs"); 
-            krb_free_document(doc); 
-            return false; 
-        }
-        if (fseek(file, doc->header.component_def_offset, SEEK_SET) != 0) { 
-            perror("seek component defs"); 
-            krb_free_document(doc); 
-            return false; 
-        }
+static bool parse_component_def_section(KrbDocument* doc, const KrbCursor* image, uint32_t load_flags) {
+    (void)load_flags;
+    if (doc->header.component_def_count == 0) return true;
+    if (doc->header.component_def_offset == 0) {
+        KRB_ERROR("Error: Zero component def offset with non-zero count.\n");
+        return false;
+    }
+    doc->component_defs = arena_calloc(doc, doc->header.component_def_count, sizeof(KrbComponentDefinition));
+    if (!doc->component_defs) return false;
+    KrbCursor section;
+    if (!open_section_internal(doc, image, doc->header.component_def_offset, &section)) return false;
+    KrbCursor* cur = &section;
+    bool wide = header_has_wide_indices(&doc->header);
 
-        for (uint16_t i = 0; i < doc->header.component_def_count; i++) {
-            unsigned char comp_header_buf[2]; // NameIdx(1)+PropDefCount(1)
-            if (fread(comp_header_buf, 1, 2, file) != 2) { 
-                fprintf(stderr, "Failed read component def header %u\n", i); 
-                krb_free_document(doc); 
-                return false; 
-            }
-            doc->component_defs[i].name_index = comp_header_buf[0];
-            doc->component_defs[i].property_def_count = comp_header_buf[1];
-            doc->component_defs[i].property_defs = NULL;
-
-            // Read property definitions
-            if (doc->component_defs[i].property_def_count > 0) {
-                doc->component_defs[i].property_defs = calloc(doc->component_defs[i].property_def_count, sizeof(KrbPropertyDefinition));
-                if (!doc->component_defs[i].property_defs) { 
-                    perror("calloc component prop defs"); 
-                    fprintf(stderr, "Component %u\n", i); 
-                    krb_free_document(doc); 
-                    return false; 
+    for (uint16_t i = 0; i < doc->header.component_def_count; i++) {
+        KrbComponentDefinition* def = &doc->component_defs[i];
+        const uint8_t* p = NULL; // NameIdx(1|2)+PropDefCount(1)
+        if (!cursor_read_index(cur, wide, &def->name_index) || !(p = cursor_take(cur, 1))) {
+            KRB_ERROR("Failed read component def header %u\n", i);
+            return false;
+        }
+        def->property_def_count = p[0];
+        if (def->property_def_count > 0) {
+            def->property_defs = arena_calloc(doc, def->property_def_count, sizeof(KrbPropertyDefinition));
+            if (!def->property_defs) return false;
+            for (uint8_t j = 0; j < def->property_def_count; j++) {
+                KrbPropertyDefinition* pd = &def->property_defs[j];
+                const uint8_t* q = NULL; // NameIdx(1|2)+TypeHint(1)+DefaultSize(1)
+                if (!cursor_read_index(cur, wide, &pd->name_index) || !(q = cursor_take(cur, 2))) {
+                    KRB_ERROR("Failed read prop def %u component %u\n", j, i);
+                    return false;
                 }
-                
-                for (uint8_t j = 0; j < doc->component_defs[i].property_def_count; j++) {
-                    unsigned char prop_def_buf[3]; // NameIdx(1)+TypeHint(1)+DefaultSize(1)
-                    if (fread(prop_def_buf, 1, 3, file) != 3) { 
-                        fprintf(stderr, "Failed read prop def %u component %u\n", j, i); 
-                        krb_free_document(doc); 
-                        return false; 
-                    }
-                    doc->component_defs[i].property_defs[j].name_index = prop_def_buf[0];
-                    doc->component_defs[i].property_defs[j].value_type_hint = prop_def_buf[1];
-                    doc->component_defs[i].property_defs[j].default_value_size = prop_def_buf[2];
-                    doc->component_defs[i].property_defs[j].default_value_data = NULL;
-
-                    // Read default value if present
-                    if (doc->component_defs[i].property_defs[j].default_value_size > 0) {
-                        doc->component_defs[i].property_defs[j].default_value_data = malloc(doc->component_defs[i].property_defs[j].default_value_size);
-                        if (!doc->component_defs[i].property_defs[j].default_value_data) { 
-                            perror("malloc component prop def default value"); 
-                            krb_free_document(doc); 
-                            return false; 
-                        }
-                        if (fread(doc->component_defs[i].property_defs[j].default_value_data, 1, 
-                                 doc->component_defs[i].property_defs[j].default_value_size, file) != 
-                            doc->component_defs[i].property_defs[j].default_value_size) {
-                            fprintf(stderr, "Failed read prop def default value %u component %u\n", j, i); 
-                            krb_free_document(doc); 
-                            return false;
-                        }
-                    }
+                pd->value_type_hint = q[0];
+                pd->default_value_size = q[1];
+                if (pd->default_value_size > 0) {
+                    const uint8_t* value = cursor_take(cur, pd->default_value_size);
+                    if (!value) { KRB_ERROR("Failed read prop def default value %u component %u\n", j, i); return false; }
+                    pd->default_value_data = (void*)value;
                 }
             }
-
-            // Read root element template
-            if (!read_element_header_internal(file, &doc->component_defs[i].root_template_header)) {
-                fprintf(stderr, "Failed reading root template header component %u\n", i); 
-                krb_free_document(doc); 
-                return false;
-            }
-            
-            // Initialize template property arrays to NULL (simplified implementation)
-            doc->component_defs[i].root_template_properties = NULL;
-            doc->component_defs[i].root_template_custom_props = NULL;
-            doc->component_defs[i].root_template_state_props = NULL; // NEW
-            doc->component_defs[i].root_template_events = NULL;
-            
-            // Skip the rest of the template for now (properties, custom props, state props, events, children)
-            // This is a simplified implementation - full version would parse these
-            long template_bytes_to_skip = 
-                (long)doc->component_defs[i].root_template_header.property_count * 3 + // Property headers (minimum)
-                (long)doc->component_defs[i].root_template_header.custom_prop_count * 3 + // Custom prop headers (minimum)
-                (long)doc->component_defs[i].root_template_header.state_prop_count * 2 + // State prop headers (minimum)
-                (long)doc->component_defs[i].root_template_header.event_count * 2 + // Events
-                (long)doc->component_defs[i].root_template_header.animation_count * 2 + // Animation refs
-                (long)doc->component_defs[i].root_template_header.child_count * 2; // Child refs
-            
-            // This is an approximation - real implementation would need to parse each section properly
-            // to know exact sizes including variable-length property values
-            if (fseek(file, template_bytes_to_skip, SEEK_CUR) != 0) {
-                fprintf(stderr, "Warning: Failed to skip template data for component %u\n", i);
-            }
         }
-    }
- 
-    // --- Read Animations (Skipped) ---
-    // TODO: Implement animation reading if needed
- 
-    // --- NEW: Read Scripts ---
-    if (doc->header.script_count > 0) {
-        if (doc->header.script_offset == 0) {
-            fprintf(stderr, "Error: Zero script offset with non-zero count.\n");
-            krb_free_document(doc);
+        if (!parse_component_template(cur, doc, def)) {
+            KRB_ERROR("Failed reading template of component %u\n", i);
             return false;
         }
-        
-        doc->scripts = calloc(doc->header.script_count, sizeof(KrbScript));
-        if (!doc->scripts) {
-            perror("calloc scripts");
-            krb_free_document(doc);
-            return false;
-        }
-        
-        if (fseek(file, doc->header.script_offset, SEEK_SET) != 0) {
-            perror("seek scripts");
-            krb_free_document(doc);
+    }
+    return true;
+}
+
+// Reads one animation track. Keyframe values are borrowed from the buffer; string and
+// resource refs are rejected so that only numeric values are ever interpolated.
+static bool cursor_read_animation_track(KrbCursor* cur, KrbDocument* doc, KrbAnimationTrack* track) {
+    const uint8_t* p = cursor_take(cur, 4); // PropId(1)+ValueType(1)+ValueSize(1)+KeyframeCount(1)
+    if (!p) return false;
+    track->property_id = p[0];
+    track->value_type = p[1];
+    track->value_size = p[2];
+    track->keyframe_count = p[3];
+    if (track->keyframe_count == 0 || track->value_type == VAL_TYPE_STRING || track->value_type == VAL_TYPE_RESOURCE) {
+        KRB_ERROR("Error: Animation track for prop 0x%02X has %u keyframes of type 0x%02X\n",
+                  track->property_id, track->keyframe_count, track->value_type);
+        return false;
+    }
+    track->keyframes = arena_calloc(doc, track->keyframe_count, sizeof(KrbKeyframe));
+    if (!track->keyframes) return false;
+    for (uint8_t k = 0; k < track->keyframe_count; k++) {
+        const uint8_t* offset = cursor_take(cur, 1);
+        const uint8_t* value = offset ? cursor_take(cur, track->value_size) : NULL;
+        if (!value) return false;
+        if (k > 0 && *offset < track->keyframes[k - 1].offset) {
+            KRB_ERROR("Error: Animation keyframe offsets go backwards (%u after %u)\n",
+                      *offset, track->keyframes[k - 1].offset);
             return false;
         }
- 
-        // Read script table header (script count)
-        unsigned char script_count_bytes[2];
-        if (fread(script_count_bytes, 1, 2, file) != 2) {
-            fprintf(stderr, "Failed read script table count\n");
-            krb_free_document(doc);
+        track->keyframes[k].offset = *offset;
+        track->keyframes[k].value = value;
+    }
+    return true;
+}
+
+static bool parse_animation_section(KrbDocument* doc, const KrbCursor* image, uint32_t load_flags) {
+    (void)load_flags;
+    if (doc->header.animation_count == 0) return true;
+    if (doc->header.animation_offset == 0) {
+        KRB_ERROR("Error: Zero animation offset with non-zero count.\n");
+        return false;
+    }
+    doc->animations = arena_calloc(doc, doc->header.animation_count, sizeof(KrbAnimation));
+    if (!doc->animations) return false;
+    KrbCursor section;
+    if (!open_section_internal(doc, image, doc->header.animation_offset, &section)) return false;
+    KrbCursor* cur = &section;
+    bool wide = header_has_wide_indices(&doc->header);
+
+    for (uint16_t i = 0; i < doc->header.animation_count; i++) {
+        KrbAnimation* anim = &doc->animations[i];
+        const uint8_t* p = NULL; // NameIdx(1|2)+Duration(2)+Easing(1)+Flags(1)+TrackCount(1)
+        if (!cursor_read_index(cur, wide, &anim->name_index) || !(p = cursor_take(cur, 5))) {
+            KRB_ERROR("Failed read animation header %u\n", i);
             return false;
         }
-        uint16_t table_script_count = krb_read_u16_le(script_count_bytes);
-        if (table_script_count != doc->header.script_count) {
-            fprintf(stderr, "Warning: Header script count %u != table count %u\n", 
-                    doc->header.script_count, table_script_count);
-        }
- 
-        // Read each script entry
-        for (uint16_t i = 0; i < doc->header.script_count; i++) {
-            if (!read_script_internal(file, &doc->scripts[i])) {
-                fprintf(stderr, "Failed reading script %u\n", i);
-                krb_free_document(doc);
-                return false;
+        anim->duration_ms = krb_read_u16_le(p);
+        anim->easing = p[2];
+        anim->flags = p[3];
+        anim->track_count = p[4];
+        if (anim->track_count > 0) {
+            anim->tracks = arena_calloc(doc, anim->track_count, sizeof(KrbAnimationTrack));
+            if (!anim->tracks) return false;
+            for (uint8_t t = 0; t < anim->track_count; t++) {
+                if (!cursor_read_animation_track(cur, doc, &anim->tracks[t])) {
+                    KRB_ERROR("Failed read track %u animation %u\n", t, i);
+                    return false;
+                }
             }
         }
     }
- 
-    // --- Read Strings ---
-    if (doc->header.string_count > 0) {
-        if (doc->header.string_offset == 0) { 
-            fprintf(stderr, "Error: Zero string offset with non-zero count.\n"); 
-            krb_free_document(doc); 
-            return false; 
-        }
-        doc->strings = calloc(doc->header.string_count, sizeof(char*));
-        if (!doc->strings) { 
-            perror("calloc strings ptrs"); 
-            krb_free_document(doc); 
-            return false; 
-        }
-        if (fseek(file, doc->header.string_offset, SEEK_SET) != 0) { 
-            perror("seek strings"); 
-            krb_free_document(doc); 
-            return false; 
-        }
- 
-        unsigned char stc_bytes[2]; 
-        if (fread(stc_bytes, 1, 2, file) != 2) { 
-            fprintf(stderr, "Failed read string table count\n"); 
-            krb_free_document(doc); 
-            return false; 
-        }
-        uint16_t table_count = krb_read_u16_le(stc_bytes);
-        if (table_count != doc->header.string_count) { 
-            fprintf(stderr, "Warning: Header string count %u != table count %u\n", doc->header.string_count, table_count); 
-        }
- 
-        for (uint16_t i = 0; i < doc->header.string_count; i++) {
-            uint8_t length;
-            if (fread(&length, 1, 1, file) != 1) { 
-                fprintf(stderr, "Failed read str len %u\n", i); 
-                krb_free_document(doc); 
-                return false; 
-            }
-            doc->strings[i] = malloc(length + 1);
-            if (!doc->strings[i]) { 
-                perror("malloc string"); 
-                fprintf(stderr, "String %u\n", i); 
-                krb_free_document(doc); 
-                return false; 
-            }
-            if (length > 0) {
-                if (fread(doc->strings[i], 1, length, file) != length) { 
-                    fprintf(stderr, "Failed read %u bytes str %u\n", length, i); 
-                    krb_free_document(doc); 
-                    return false; 
-                }
-            }
-            doc->strings[i][length] = '\0';
-        }
-    }
- 
-    // --- Read Resources ---
-    if (doc->header.resource_count > 0) {
-        if (doc->header.resource_offset == 0) { 
-            fprintf(stderr, "Error: Zero resource offset with non-zero count.\n"); 
-            krb_free_document(doc); 
-            return false; 
-        }
-        doc->resources = calloc(doc->header.resource_count, sizeof(KrbResource));
-        if (!doc->resources) { 
-            perror("calloc resources"); 
-            krb_free_document(doc); 
-            return false; 
-        }
-        if (fseek(file, doc->header.resource_offset, SEEK_SET) != 0) { 
-            perror("seek resources"); 
-            krb_free_document(doc); 
-            return false; 
-        }
- 
-        unsigned char resc_bytes[2];
-        if (fread(resc_bytes, 1, 2, file) != 2) { 
-            fprintf(stderr, "Failed read resource table count\n"); 
-            krb_free_document(doc); 
-            return false; 
-        }
-        uint16_t table_res_count = krb_read_u16_le(resc_bytes);
-        if (table_res_count != doc->header.resource_count) { 
-            fprintf(stderr, "Warning: Header resource count %u != table count %u\n", doc->header.resource_count, table_res_count); 
-        }
- 
-        for (uint16_t i = 0; i < doc->header.resource_count; i++) {
-            unsigned char res_entry_buf[4]; // Type(1)+NameIdx(1)+Format(1)+DataIdx(1)
-            if (fread(res_entry_buf, 1, 4, file) != 4) {
-                fprintf(stderr, "Error: Failed read resource entry %u\n", i);
-                krb_free_document(doc); 
-                return false;
-            }
-            doc->resources[i].type = res_entry_buf[0];
-            doc->resources[i].name_index = res_entry_buf[1];
-            doc->resources[i].format = res_entry_buf[2];
-            
-            if (doc->resources[i].format == RES_FORMAT_EXTERNAL) {
-                doc->resources[i].data_string_index = res_entry_buf[3];
-            } else if (doc->resources[i].format == RES_FORMAT_INLINE) {
-                fprintf(stderr, "Error: Inline resource parsing not yet implemented (Res %u).\n", i);
-                krb_free_document(doc); 
-                return false;
-            } else {
-                fprintf(stderr, "Error: Unknown resource format 0x%02X for resource %u\n", doc->resources[i].format, i);
-                krb_free_document(doc); 
-                return false;
-            }
+    return true;
+}
+
+static bool parse_script_section(KrbDocument* doc, const KrbCursor* image, uint32_t load_flags) {
+    (void)load_flags;
+    if (doc->header.script_count == 0) return true;
+    if (doc->header.script_offset == 0) {
+        KRB_ERROR("Error: Zero script offset with non-zero count.\n");
+        return false;
+    }
+    doc->scripts = arena_calloc(doc, doc->header.script_count, sizeof(KrbScript));
+    if (!doc->scripts) return false;
+    KrbCursor section;
+    if (!open_section_internal(doc, image, doc->header.script_offset, &section)) return false;
+    KrbCursor* cur = &section;
+    const uint8_t* p = cursor_take(cur, 2);
+    if (!p) { KRB_ERROR("Failed read script table count\n"); return false; }
+    uint16_t table_script_count = krb_read_u16_le(p);
+    if (table_script_count != doc->header.script_count) {
+        KRB_ERROR("Warning: Header script count %u != table count %u\n",
+                doc->header.script_count, table_script_count);
+    }
+    for (uint16_t i = 0; i < doc->header.script_count; i++) {
+        if (!cursor_read_script(cur, doc, &doc->scripts[i])) {
+            KRB_ERROR("Failed reading script %u\n", i);
+            return false;
         }
     }
- 
     return true;
- }
- 
- // Frees all memory allocated within the KrbDocument structure.
- void krb_free_document(KrbDocument* doc) {
-    if (!doc) return;
- 
-    // Free Element Data (Properties, Custom Properties, State Properties, and Events)
-    if (doc->elements) {
-        for (uint16_t i = 0; i < doc->header.element_count; i++) {
-            // Free standard properties
-            if (doc->properties && doc->properties[i]) {
-                for (uint8_t j = 0; j < doc->elements[i].property_count; j++) {
-                    if (doc->properties[i][j].value) {
-                        free(doc->properties[i][j].value);
-                    }
-                }
-                free(doc->properties[i]);
-            }
-            
-            // Free custom properties
-            if (doc->custom_properties && doc->custom_properties[i]) {
-                for (uint8_t j = 0; j < doc->elements[i].custom_prop_count; j++) {
-                    if (doc->custom_properties[i][j].value) {
-                        free(doc->custom_properties[i][j].value);
-                    }
-                }
-                free(doc->custom_properties[i]);
-            }
-            
-            // NEW: Free state properties
-            if (doc->state_properties && doc->state_properties[i]) {
-                for (uint8_t j = 0; j < doc->elements[i].state_prop_count; j++) {
-                    if (doc->state_properties[i][j].properties) {
-                        // Free individual properties within the state set
-                        for (uint8_t k = 0; k < doc->state_properties[i][j].property_count; k++) {
-                            if (doc->state_properties[i][j].properties[k].value) {
-                                free(doc->state_properties[i][j].properties[k].value);
-                            }
-                        }
-                        free(doc->state_properties[i][j].properties);
-                    }
-                }
-                free(doc->state_properties[i]);
-            }
-            
-            // Free events
-            if (doc->events && doc->events[i]) {
-                free(doc->events[i]);
-            }
+}
+
+static bool cursor_read_string_length(KrbCursor* cur, bool wide, uint32_t* length) {
+    if (wide) return cursor_read_varint(cur, length);
+    const uint8_t* p = cursor_take(cur, 1);
+    if (!p) return false;
+    *length = p[0];
+    return true;
+}
+
+// Strings are length-prefixed in the file, but every consumer expects C strings,
+// so they are copied once into a single NUL-terminated arena block.
+static bool parse_string_section(KrbDocument* doc, const KrbCursor* image, uint32_t load_flags) {
+    (void)load_flags;
+    if (doc->header.string_count == 0) return true;
+    uint16_t count = doc->header.string_count;
+    if (doc->header.string_offset == 0) {
+        KRB_ERROR("Error: Zero string offset with non-zero count.\n");
+        return false;
+    }
+    KrbCursor section;
+    if (!open_section_internal(doc, image, doc->header.string_offset, &section)) return false;
+    KrbCursor* cur = &section;
+    const uint8_t* p = cursor_take(cur, 2);
+    if (!p) { KRB_ERROR("Failed read string table count\n"); return false; }
+    uint16_t table_count = krb_read_u16_le(p);
+    if (table_count != count) {
+        KRB_ERROR("Warning: Header string count %u != table count %u\n", count, table_count);
+    }
+
+    // First pass sizes the block, second pass copies. Lengths are one byte in v0.5, varints in v0.6.
+    bool wide = header_has_wide_indices(&doc->header);
+    size_t table_start = cur->pos;
+    size_t block_size = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        uint32_t length;
+        if (!cursor_read_string_length(cur, wide, &length) || !cursor_take(cur, length)) {
+            KRB_ERROR("Failed read str %u\n", i);
+            return false;
         }
+        block_size += (size_t)length + 1;
     }
-    
-    // Free top-level pointer arrays
-    if (doc->properties) free(doc->properties);
-    if (doc->custom_properties) free(doc->custom_properties);
-    if (doc->state_properties) free(doc->state_properties); // NEW
-    if (doc->events) free(doc->events);
-    if (doc->elements) free(doc->elements);
- 
-    // Free Styles
-    if (doc->styles) {
-        for (uint16_t i = 0; i < doc->header.style_count; i++) {
-            if (doc->styles[i].properties) {
-                for (uint8_t j = 0; j < doc->styles[i].property_count; j++) {
-                    if (doc->styles[i].properties[j].value) {
-                        free(doc->styles[i].properties[j].value);
-                    }
-                }
-                free(doc->styles[i].properties);
-            }
+    doc->strings = arena_calloc(doc, count, sizeof(char*));
+    char* out = krb_document_alloc(doc, block_size);
+    if (!doc->strings || !out) return false;
+
+    cur->pos = table_start;
+    for (uint16_t i = 0; i < count; i++) {
+        uint32_t length;
+        cursor_read_string_length(cur, wide, &length);
+        memcpy(out, cursor_take(cur, length), length);
+        out[length] = '\0';
+        doc->strings[i] = out;
+        out += (size_t)length + 1;
+    }
+    return intern_strings_internal(doc);
+}
+
+static bool parse_resource_section(KrbDocument* doc, const KrbCursor* image, uint32_t load_flags) {
+    (void)load_flags;
+    if (doc->header.resource_count == 0) return true;
+    if (doc->header.resource_offset == 0) {
+        KRB_ERROR("Error: Zero resource offset with non-zero count.\n");
+        return false;
+    }
+    doc->resources = arena_calloc(doc, doc->header.resource_count, sizeof(KrbResource));
+    if (!doc->resources) return false;
+    KrbCursor section;
+    if (!open_section_internal(doc, image, doc->header.resource_offset, &section)) return false;
+    KrbCursor* cur = &section;
+    const uint8_t* p = cursor_take(cur, 2);
+    if (!p) { KRB_ERROR("Failed read resource table count\n"); return false; }
+    uint16_t table_res_count = krb_read_u16_le(p);
+    if (table_res_count != doc->header.resource_count) {
+        KRB_ERROR("Warning: Header resource count %u != table count %u\n", doc->header.resource_count, table_res_count);
+    }
+    bool wide = header_has_wide_indices(&doc->header);
+    for (uint16_t i = 0; i < doc->header.resource_count; i++) {
+        // Type(1)+NameIdx(1|2)+Format(1)
+        const uint8_t* type = cursor_take(cur, 1);
+        const uint8_t* format = NULL;
+        if (!type || !cursor_read_index(cur, wide, &doc->resources[i].name_index) || !(format = cursor_take(cur, 1))) {
+            KRB_ERROR("Error: Failed read resource entry %u\n", i);
+            return false;
         }
-        free(doc->styles);
-    }
- 
-    // Free Component Definitions
-    if (doc->component_defs) {
-        for (uint16_t i = 0; i < doc->header.component_def_count; i++) {
-            if (doc->component_defs[i].property_defs) {
-                for (uint8_t j = 0; j < doc->component_defs[i].property_def_count; j++) {
-                    if (doc->component_defs[i].property_defs[j].default_value_data) {
-                        free(doc->component_defs[i].property_defs[j].default_value_data);
-                    }
-                }
-                free(doc->component_defs[i].property_defs);
-            }
-            // Free template arrays (if they were allocated)
-            if (doc->component_defs[i].root_template_properties) {
-                // Would need to free individual property values here
-                free(doc->component_defs[i].root_template_properties);
-            }
-            if (doc->component_defs[i].root_template_custom_props) {
-                // Would need to free individual custom property values here
-                free(doc->component_defs[i].root_template_custom_props);
-            }
-            if (doc->component_defs[i].root_template_state_props) { // NEW
-                // Would need to free individual state property sets here
-                free(doc->component_defs[i].root_template_state_props);
-            }
-            if (doc->component_defs[i].root_template_events) {
-                free(doc->component_defs[i].root_template_events);
+        doc->resources[i].type = type[0];
+        doc->resources[i].format = format[0];
+        if (format[0] == RES_FORMAT_EXTERNAL) {
+            // DataStringIdx(1|2)
+            if (!cursor_read_index(cur, wide, &doc->resources[i].data_string_index)) {
+                KRB_ERROR("Error: Failed read resource entry %u\n", i);
+                return false;
             }
+        } else if (format[0] == RES_FORMAT_INLINE) {
+            // DataSize(2) followed by the raw blob, which is borrowed from the buffer
+            const uint8_t* size_bytes = cursor_take(cur, 2);
+            if (!size_bytes) { KRB_ERROR("Error: Failed read inline size for resource %u\n", i); return false; }
+            uint16_t blob_size = krb_read_u16_le(size_bytes);
+            const uint8_t* blob = cursor_take(cur, blob_size);
+            if (!blob) { KRB_ERROR("Error: Failed read %u inline bytes for resource %u\n", blob_size, i); return false; }
+            doc->resources[i].inline_data = blob;
+            doc->resources[i].inline_data_size = blob_size;
+        } else {
+            KRB_ERROR("Error: Unknown resource format 0x%02X for resource %u\n", format[0], i);
+            return false;
         }
-        free(doc->component_defs);
     }
- 
-    // NEW: Free Scripts
-    if (doc->scripts) {
-        for (uint16_t i = 0; i < doc->header.script_count; i++) {
-            // Free entry points
-            if (doc->scripts[i].entry_points) {
-                free(doc->scripts[i].entry_points);
-            }
-            // Free inline code data
-            if (doc->scripts[i].code_data) {
-                free(doc->scripts[i].code_data);
-            }
+    return true;
+}
+
+typedef bool (*KrbSectionParser)(KrbDocument* doc, const KrbCursor* image, uint32_t load_flags);
+
+typedef struct {
+    KrbSectionParser parse;
+    uint16_t count;
+    uint32_t offset;
+} KrbSectionTask;
+
+#define KRB_SECTION_TASK_COUNT 7
+
+// Sections in file order; a failing section stops the load with its own diagnostic
+static void section_tasks_internal(const KrbHeader* h, KrbSectionTask tasks[KRB_SECTION_TASK_COUNT]) {
+    const KrbSectionTask all[KRB_SECTION_TASK_COUNT] = {
+        { parse_element_section,       h->element_count,       h->element_offset },
+        { parse_style_section,         h->style_count,         h->style_offset },
+        { parse_component_def_section, h->component_def_count, h->component_def_offset },
+        { parse_animation_section,     h->animation_count,     h->animation_offset },
+        { parse_script_section,        h->script_count,        h->script_offset },
+        { parse_string_section,        h->string_count,        h->string_offset },
+        { parse_resource_section,      h->resource_count,      h->resource_offset },
+    };
+    memcpy(tasks, all, sizeof(all));
+}
+
+#ifndef KRB_NO_THREADS
+
+// --- Parallel Section Decoding ---
+// With KRB_LOAD_PARALLEL each non-empty section is decoded into its own shard document
+// (a header copy plus a private arena), so workers never share an allocator. Shards are
+// folded back into the document after the join.
+
+#define KRB_PARALLEL_MAX_THREADS 4
+// Below this image size thread start-up costs more than decoding saves
+#define KRB_PARALLEL_MIN_SIZE (16 * 1024)
+// First shard block per on-disk section byte (decoded properties take ~5x their encoding)
+#define KRB_PARALLEL_ARENA_FACTOR 6
+
+typedef struct {
+    const KrbCursor* image;
+    uint32_t load_flags;
+    KrbSectionTask tasks[KRB_SECTION_TASK_COUNT];
+    KrbDocument shards[KRB_SECTION_TASK_COUNT];
+    bool ok[KRB_SECTION_TASK_COUNT];
+    size_t task_count;
+    size_t next_task;
+    pthread_mutex_t lock;
+} KrbParallelJob;
+
+static void* parallel_worker(void* arg) {
+    KrbParallelJob* job = arg;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        size_t i = job->next_task++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->task_count) return NULL;
+        job->ok[i] = job->tasks[i].parse(&job->shards[i], job->image, job->load_flags);
+    }
+}
+
+// Moves a shard's section fields, statistics and arena blocks into 'doc'. A shard only
+// sets the fields of its own section, so non-NULL fields never collide.
+#define KRB_ADOPT_FIELD(field) do { if (shard->field) doc->field = shard->field; } while (0)
+
+static void adopt_shard_internal(KrbDocument* doc, KrbDocument* shard) {
+    KRB_ADOPT_FIELD(elements);
+    KRB_ADOPT_FIELD(element_offsets);
+    KRB_ADOPT_FIELD(element_decoded);
+    KRB_ADOPT_FIELD(element_parent);
+    KRB_ADOPT_FIELD(element_first_child);
+    KRB_ADOPT_FIELD(element_next_sibling);
+    KRB_ADOPT_FIELD(properties);
+    KRB_ADOPT_FIELD(property_index);
+    KRB_ADOPT_FIELD(custom_properties);
+    KRB_ADOPT_FIELD(state_properties);
+    KRB_ADOPT_FIELD(events);
+    KRB_ADOPT_FIELD(animation_refs);
+    KRB_ADOPT_FIELD(element_section);
+    KRB_ADOPT_FIELD(element_section_size);
+    KRB_ADOPT_FIELD(styles);
+    KRB_ADOPT_FIELD(component_defs);
+    KRB_ADOPT_FIELD(animations);
+    KRB_ADOPT_FIELD(scripts);
+    KRB_ADOPT_FIELD(strings);
+    KRB_ADOPT_FIELD(string_atoms);
+    KRB_ADOPT_FIELD(string_hashes);
+    KRB_ADOPT_FIELD(string_slots);
+    KRB_ADOPT_FIELD(string_slot_mask);
+    KRB_ADOPT_FIELD(resources);
+    doc->compressed_bytes += shard->compressed_bytes;
+    doc->uncompressed_bytes += shard->uncompressed_bytes;
+    doc->sections_decompressed += shard->sections_decompressed;
+
+    // Splice the shard's blocks in behind the document's current block
+    if (shard->arena) {
+        KrbArenaBlock* tail = shard->arena;
+        while (tail->next) tail = tail->next;
+        if (doc->arena) {
+            tail->next = doc->arena->next;
+            doc->arena->next = shard->arena;
+        } else {
+            doc->arena = shard->arena;
         }
-        free(doc->scripts);
+        shard->arena = NULL;
     }
- 
-    // Free Strings
-    if (doc->strings) {
-        for (uint16_t i = 0; i < doc->header.string_count; i++) {
-            if (doc->strings[i]) {
-                free(doc->strings[i]);
-            }
+}
+
+#undef KRB_ADOPT_FIELD
+
+// Decodes the non-empty sections concurrently and joins before returning. Returns false
+// (with everything allocated so far owned by 'doc') if any section fails.
+static bool parse_sections_parallel(KrbDocument* doc, const KrbCursor* image, uint32_t load_flags,
+                                    const KrbSectionTask* tasks) {
+    KrbParallelJob* job = calloc(1, sizeof(KrbParallelJob));
+    if (!job) {
+        KRB_PERROR("calloc KRB parallel job");
+        return false;
+    }
+    job->image = image;
+    job->load_flags = load_flags;
+    for (size_t i = 0; i < KRB_SECTION_TASK_COUNT; i++) {
+        if (tasks[i].count == 0) continue;
+        size_t n = job->task_count++;
+        job->tasks[n] = tasks[i];
+        job->shards[n].header = doc->header;
+        job->shards[n].version_major = doc->version_major;
+        job->shards[n].version_minor = doc->version_minor;
+        job->shards[n].arena = arena_new_block(
+            section_span_internal(&doc->header, tasks[i].offset, image->size) * KRB_PARALLEL_ARENA_FACTOR);
+    }
+    pthread_mutex_init(&job->lock, NULL);
+
+    // The calling thread works too, so at most task_count - 1 helpers are started
+    pthread_t threads[KRB_PARALLEL_MAX_THREADS - 1];
+    size_t started = 0;
+    while (started < KRB_PARALLEL_MAX_THREADS - 1 && started + 1 < job->task_count) {
+        if (pthread_create(&threads[started], NULL, parallel_worker, job) != 0) break;
+        started++;
+    }
+    parallel_worker(job);
+    for (size_t t = 0; t < started; t++) pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&job->lock);
+
+    bool ok = true;
+    for (size_t i = 0; i < job->task_count; i++) {
+        adopt_shard_internal(doc, &job->shards[i]);
+        ok = ok && job->ok[i];
+    }
+    free(job);
+    return ok;
+}
+
+#endif // KRB_NO_THREADS
+
+// Parses every section of an in-memory KRB image. On failure the caller frees doc.
+static bool parse_buffer_internal(KrbCursor* image, uint32_t load_flags, KrbDocument* doc) {
+    const uint8_t* header_bytes = cursor_take(image, 54);
+    if (!header_bytes || !decode_header_internal(header_bytes, &doc->header)) {
+        return false;
+    }
+#if defined(DEBUG) && !defined(KRB_NO_STDIO)
+    printf("DEBUG: Read offsets from buffer:\n");
+    printf("  element_offset = %u\n", doc->header.element_offset);
+    printf("  style_offset = %u\n", doc->header.style_offset);
+    printf("  string_offset = %u\n", doc->header.string_offset);
+    printf("  resource_offset = %u\n", doc->header.resource_offset);
+#endif
+    doc->version_major = (doc->header.version & 0x00FF);
+    doc->version_minor = (doc->header.version >> 8);
+    if (doc->version_major != KRB_SPEC_VERSION_MAJOR || doc->version_minor < KRB_SPEC_VERSION_MINOR_COMPAT ||
+        doc->version_minor > KRB_SPEC_VERSION_MINOR) {
+        KRB_ERROR("Error: Unsupported KRB version %u.%u (reader handles %u.%u-%u.%u)\n",
+                  doc->version_major, doc->version_minor, KRB_SPEC_VERSION_MAJOR, KRB_SPEC_VERSION_MINOR_COMPAT,
+                  KRB_SPEC_VERSION_MAJOR, KRB_SPEC_VERSION_MINOR);
+        return false;
+    }
+
+    KrbSectionTask tasks[KRB_SECTION_TASK_COUNT];
+    section_tasks_internal(&doc->header, tasks);
+
+#ifndef KRB_NO_THREADS
+    if ((load_flags & KRB_LOAD_PARALLEL) && image->size >= KRB_PARALLEL_MIN_SIZE) {
+        return parse_sections_parallel(doc, image, load_flags, tasks);
+    }
+#endif
+    if (!arena_reserve_internal(doc, image->size)) {
+        return false;
+    }
+    for (size_t i = 0; i < KRB_SECTION_TASK_COUNT; i++) {
+        if (!tasks[i].parse(doc, image, load_flags)) return false;
+    }
+    return true;
+}
+
+// --- Public API Functions ---
+
+// Parses a caller-owned KRB image in place with the given KRB_LOAD_* flags.
+bool krb_read_document_from_buffer_ex(const uint8_t* data, size_t size, uint32_t load_flags, KrbDocument* doc) {
+    if (!data || !doc) return false;
+    memset(doc, 0, sizeof(KrbDocument));
+    doc->data = data;
+    doc->data_size = size;
+
+    KrbCursor cur = { data, size, 0 };
+    if (!parse_buffer_internal(&cur, load_flags, doc)) {
+        krb_free_document(doc);
+        return false;
+    }
+    return true;
+}
+
+// Parses a caller-owned KRB image in place. The buffer must outlive the document.
+bool krb_read_document_from_buffer(const uint8_t* data, size_t size, KrbDocument* doc) {
+    return krb_read_document_from_buffer_ex(data, size, 0, doc);
+}
+
+// Returns element 'index', decoding its body first if it was loaded lazily.
+const KrbElementHeader* krb_get_element(KrbDocument* doc, uint16_t index) {
+    if (!doc || !doc->elements || index >= doc->header.element_count) return NULL;
+    if (!decode_element_body_internal(doc, index)) return NULL;
+    return &doc->elements[index];
+}
+
+// Returns the standard properties of element 'index' (NULL if it has none).
+KrbProperty* krb_get_element_properties(KrbDocument* doc, uint16_t index) {
+    if (!krb_get_element(doc, index)) return NULL;
+    return doc->properties[index];
+}
+
+// Resolves a name to its atom with one hash and, on a hash match, one strcmp.
+KrbAtom krb_find_atom(const KrbDocument* doc, const char* name) {
+    if (!doc || !name || !doc->string_slots) return KRB_INVALID_ATOM;
+    uint32_t hash = string_hash_internal(name);
+    for (uint32_t slot = hash & doc->string_slot_mask; ; slot = (slot + 1) & doc->string_slot_mask) {
+        uint16_t atom = doc->string_slots[slot];
+        if (atom == KRB_INVALID_INDEX) return KRB_INVALID_ATOM;
+        if (doc->string_hashes[atom] == hash && strcmp(doc->strings[atom], name) == 0) return atom;
+    }
+}
+
+// Maps a string table index (as stored in properties and headers) to its atom.
+KrbAtom krb_string_atom(const KrbDocument* doc, uint16_t index) {
+    if (!doc || !doc->string_atoms || index >= doc->header.string_count) return KRB_INVALID_ATOM;
+    return doc->string_atoms[index];
+}
+
+// Returns the last property with 'property_id' in 'props' (NULL if absent).
+const KrbProperty* krb_find_property(const KrbProperty* props, uint8_t count, const KrbPropertyIndex* index, uint8_t property_id) {
+    if (!props) return NULL;
+    if (index && property_id < KRB_PROPERTY_INDEX_LIMIT) {
+        uint64_t bit = (uint64_t)1 << property_id;
+        if (!(index->mask & bit)) return NULL;
+        return &props[index->slots[__builtin_popcountll(index->mask & (bit - 1))]];
+    }
+    for (uint8_t j = count; j > 0; j--) {
+        if (props[j - 1].property_id == property_id) return &props[j - 1];
+    }
+    return NULL;
+}
+
+// Looks up a direct property of element 'element', decoding it first if loaded lazily.
+const KrbProperty* krb_get_element_property(KrbDocument* doc, uint16_t element, uint8_t property_id) {
+    if (!krb_get_element(doc, element)) return NULL;
+    return krb_find_property(doc->properties[element], doc->elements[element].property_count,
+                             &doc->property_index[element], property_id);
+}
+
+// Looks up a property of the style with 1-based 'style_id'.
+const KrbProperty* krb_get_style_property(const KrbDocument* doc, uint16_t style_id, uint8_t property_id) {
+    if (!doc || !doc->styles || style_id == 0 || style_id > doc->header.style_count) return NULL;
+    const KrbStyle* style = &doc->styles[style_id - 1];
+    return krb_find_property(style->properties, style->property_count, &style->property_index, property_id);
+}
+
+#ifndef KRB_NO_STDIO
+
+// Reads the entire KRB document structure into memory with the given KRB_LOAD_* flags.
+// The stream is slurped once into a buffer owned by the document and parsed from there,
+// so non-seekable streams (pipes, stdin) work as well as regular files.
+bool krb_read_document_ex(FILE* file, uint32_t load_flags, KrbDocument* doc) {
+    if (!file || !doc) return false;
+    memset(doc, 0, sizeof(KrbDocument));
+
+    size_t capacity = 4096;
+    size_t size = 0;
+    uint8_t* buffer = malloc(capacity);
+    if (!buffer) {
+        KRB_PERROR("malloc KRB read buffer");
+        return false;
+    }
+    for (;;) {
+        size += fread(buffer + size, 1, capacity - size, file);
+        if (size < capacity) break;
+        uint8_t* grown = realloc(buffer, capacity * 2);
+        if (!grown) {
+            KRB_PERROR("realloc KRB read buffer");
+            free(buffer);
+            return false;
         }
-        free(doc->strings);
+        buffer = grown;
+        capacity *= 2;
+    }
+    if (ferror(file)) {
+        KRB_PERROR("read KRB stream");
+        free(buffer);
+        return false;
+    }
+
+    if (!krb_read_document_from_buffer_ex(buffer, size, load_flags, doc)) {
+        free(buffer);
+        return false;
+    }
+    doc->data_is_owned = true;
+    return true;
+}
+
+// Reads the entire KRB document structure into memory.
+bool krb_read_document(FILE* file, KrbDocument* doc) {
+    return krb_read_document_ex(file, 0, doc);
+}
+
+// Maps a KRB file read-only and parses it in place with the given KRB_LOAD_* flags.
+bool krb_map_document_ex(const char* path, uint32_t load_flags, KrbDocument* doc) {
+    if (!path || !doc) return false;
+    memset(doc, 0, sizeof(KrbDocument));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        KRB_ERROR("Error: Cannot open '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        KRB_ERROR("Error: Cannot stat '%s' or file is empty\n", path);
+        close(fd);
+        return false;
     }
- 
-    // Free Resources
-    if (doc->resources) {
-        free(doc->resources);
+    size_t size = (size_t)st.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps its own reference to the file
+    if (mapping == MAP_FAILED) {
+        KRB_PERROR("mmap KRB file");
+        return false;
+    }
+
+    if (!krb_read_document_from_buffer_ex(mapping, size, load_flags, doc)) {
+        munmap(mapping, size);
+        return false;
     }
+    doc->data_is_mapped = true;
+    return true;
+}
+
+// Maps a KRB file read-only and parses it in place.
+bool krb_map_document(const char* path, KrbDocument* doc) {
+    return krb_map_document_ex(path, 0, doc);
+}
+
+#endif // KRB_NO_STDIO
+
+ // Frees all memory allocated within the KrbDocument structure.
+ void krb_free_document(KrbDocument* doc) {
+    if (!doc) return;
+
+    // Every parsed array and value lives in the arena, so the whole document goes in one walk
+    KrbArenaBlock* block = doc->arena;
+    while (block) {
+        KrbArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    // Release the backing buffer last; borrowed values point into it
+#ifndef KRB_NO_STDIO
+    if (doc->data_is_mapped && doc->data) {
+        munmap((void*)doc->data, doc->data_size);
+    }
+#endif
+    if (doc->data_is_owned) {
+        free((void*)doc->data);
+    }
+
+    // Leave the document empty so a second free (e.g. after a failed read) is harmless
+    memset(doc, 0, sizeof(KrbDocument));
  }
@@ -0,0 +1,448 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "krb.h"
+
+// --- Output Buffer ---
+// The document is serialized into one growable buffer; section offsets are known only
+// after earlier sections are written, so child refs and the header are patched in place.
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    bool failed;
+    bool wide;     // v0.6 output: two-byte string/style/child indices, varint string lengths
+} KrbWriteBuffer;
+
+static void wb_put(KrbWriteBuffer* wb, const void* bytes, size_t count) {
+    if (wb->failed || count == 0) return;
+    if (count > wb->capacity - wb->size) {
+        size_t capacity = wb->capacity ? wb->capacity : 4096;
+        while (count > capacity - wb->size) capacity *= 2;
+        uint8_t* grown = realloc(wb->data, capacity);
+        if (!grown) {
+            perror("realloc KRB write buffer");
+            wb->failed = true;
+            return;
+        }
+        wb->data = grown;
+        wb->capacity = capacity;
+    }
+    memcpy(wb->data + wb->size, bytes, count);
+    wb->size += count;
+}
+
+static void wb_u8(KrbWriteBuffer* wb, uint8_t v) {
+    wb_put(wb, &v, 1);
+}
+
+static void wb_u16(KrbWriteBuffer* wb, uint16_t v) {
+    uint8_t b[2] = { (uint8_t)(v & 0xFF), (uint8_t)(v >> 8) };
+    wb_put(wb, b, 2);
+}
+
+// Writes a string, style or callback index at the width of the output revision
+static void wb_index(KrbWriteBuffer* wb, uint16_t v) {
+    if (wb->wide) wb_u16(wb, v);
+    else wb_u8(wb, (uint8_t)v);
+}
+
+static void wb_varint(KrbWriteBuffer* wb, uint32_t v) {
+    while (v >= 0x80) {
+        wb_u8(wb, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    wb_u8(wb, (uint8_t)v);
+}
+
+static void wb_patch_u16(KrbWriteBuffer* wb, size_t at, uint16_t v) {
+    if (wb->failed) return;
+    wb->data[at] = (uint8_t)(v & 0xFF);
+    wb->data[at + 1] = (uint8_t)(v >> 8);
+}
+
+static void wb_patch_u32(KrbWriteBuffer* wb, size_t at, uint32_t v) {
+    if (wb->failed) return;
+    for (int i = 0; i < 4; i++) wb->data[at + i] = (uint8_t)(v >> (8 * i));
+}
+
+// --- Element Blocks ---
+
+// Writes an element header (18 bytes, 21 when wide); the child count is passed separately
+// because the writer, not the in-memory header, decides how many children are emitted.
+static void write_element_header(KrbWriteBuffer* wb, const KrbElementHeader* h, uint16_t child_count) {
+    wb_u8(wb, h->type);
+    wb_index(wb, h->id);
+    wb_u16(wb, h->pos_x);
+    wb_u16(wb, h->pos_y);
+    wb_u16(wb, h->width);
+    wb_u16(wb, h->height);
+    wb_u8(wb, h->layout);
+    wb_index(wb, h->style_id);
+    wb_u8(wb, h->property_count);
+    wb_index(wb, child_count);
+    wb_u8(wb, h->event_count);
+    wb_u8(wb, h->animation_count);
+    wb_u8(wb, h->custom_prop_count);
+    wb_u8(wb, h->state_prop_count);
+}
+
+static void write_properties(KrbWriteBuffer* wb, const KrbProperty* props, uint8_t count) {
+    for (uint8_t j = 0; j < count; j++) {
+        wb_u8(wb, props[j].property_id);
+        wb_u8(wb, props[j].value_type);
+        wb_u8(wb, props[j].size);
+        wb_put(wb, props[j].value, props[j].size);
+    }
+}
+
+// Writes everything after the header up to (not including) the child refs
+static void write_element_body(KrbWriteBuffer* wb, const KrbElementHeader* h, const KrbProperty* props,
+                               const KrbCustomProperty* custom, const KrbStatePropertySet* states,
+                               const KrbEventFileEntry* events, const KrbAnimationRef* anim_refs) {
+    write_properties(wb, props, h->property_count);
+    for (uint8_t j = 0; j < h->custom_prop_count; j++) {
+        wb_index(wb, custom[j].key_index);
+        wb_u8(wb, custom[j].value_type);
+        wb_u8(wb, custom[j].value_size);
+        wb_put(wb, custom[j].value, custom[j].value_size);
+    }
+    for (uint8_t j = 0; j < h->state_prop_count; j++) {
+        wb_u8(wb, states[j].state_flags);
+        wb_u8(wb, states[j].property_count);
+        write_properties(wb, states[j].properties, states[j].property_count);
+    }
+    for (uint8_t j = 0; j < h->event_count; j++) {
+        wb_u8(wb, events[j].event_type);
+        wb_index(wb, events[j].callback_id);
+    }
+    wb_put(wb, anim_refs, (size_t)h->animation_count * sizeof(KrbAnimationRef));
+}
+
+// Child refs are u16 offsets from the parent's header to the child's, so children must
+// be written after their parent and within 64 KiB of it.
+static bool encode_child_ref(KrbWriteBuffer* wb, size_t ref_pos, size_t parent_off, size_t child_off) {
+    if (child_off <= parent_off || child_off - parent_off > 0xFFFF) {
+        fprintf(stderr, "Error: Child at byte %zu cannot be referenced from parent at byte %zu "
+                        "(elements must be in pre-order and within 64 KiB)\n", child_off, parent_off);
+        return false;
+    }
+    wb_patch_u16(wb, ref_pos, (uint16_t)(child_off - parent_off));
+    return true;
+}
+
+static bool write_elements(KrbWriteBuffer* wb, KrbDocument* doc) {
+    uint16_t count = doc->header.element_count;
+    size_t* header_off = calloc(count, sizeof(size_t));
+    size_t* refs_off = calloc(count, sizeof(size_t));
+    if (!header_off || !refs_off) {
+        perror("calloc element offsets");
+        free(header_off);
+        free(refs_off);
+        return false;
+    }
+
+    bool ok = true;
+    for (uint16_t i = 0; i < count && ok; i++) {
+        if (!krb_get_element(doc, i)) { ok = false; break; }
+
+        uint16_t child_count = 0;
+        if (doc->element_first_child) {
+            for (uint16_t c = doc->element_first_child[i]; c != KRB_INVALID_INDEX; c = doc->element_next_sibling[c]) {
+                child_count++;
+            }
+        }
+        header_off[i] = wb->size;
+        write_element_header(wb, &doc->elements[i], child_count);
+        write_element_body(wb, &doc->elements[i], doc->properties[i], doc->custom_properties[i],
+                           doc->state_properties[i], doc->events[i], doc->animation_refs[i]);
+        refs_off[i] = wb->size;
+        for (uint16_t k = 0; k < child_count; k++) wb_u16(wb, 0); // Patched below
+    }
+
+    for (uint16_t i = 0; i < count && ok && doc->element_first_child; i++) {
+        size_t ref = refs_off[i];
+        for (uint16_t c = doc->element_first_child[i]; c != KRB_INVALID_INDEX && ok; c = doc->element_next_sibling[c]) {
+            ok = encode_child_ref(wb, ref, header_off[i], header_off[c]);
+            ref += 2;
+        }
+    }
+
+    free(header_off);
+    free(refs_off);
+    return ok;
+}
+
+static bool write_component_defs(KrbWriteBuffer* wb, const KrbDocument* doc) {
+    for (uint16_t i = 0; i < doc->header.component_def_count; i++) {
+        const KrbComponentDefinition* def = &doc->component_defs[i];
+        wb_index(wb, def->name_index);
+        wb_u8(wb, def->property_def_count);
+        for (uint8_t j = 0; j < def->property_def_count; j++) {
+            const KrbPropertyDefinition* pd = &def->property_defs[j];
+            wb_index(wb, pd->name_index);
+            wb_u8(wb, pd->value_type_hint);
+            wb_u8(wb, pd->default_value_size);
+            wb_put(wb, pd->default_value_data, pd->default_value_size);
+        }
+
+        // Template elements are already in pre-order; a parent's children are the later
+        // elements naming it as parent_index, in index order.
+        uint16_t n = def->template_element_count;
+        size_t* header_off = calloc(n ? n : 1, sizeof(size_t));
+        size_t* refs_off = calloc(n ? n : 1, sizeof(size_t));
+        uint16_t* child_counts = calloc(n ? n : 1, sizeof(uint16_t));
+        if (!header_off || !refs_off || !child_counts) {
+            perror("calloc template offsets");
+            free(header_off); free(refs_off); free(child_counts);
+            return false;
+        }
+        for (uint16_t t = 1; t < n; t++) {
+            if (def->template_elements[t].parent_index < n) child_counts[def->template_elements[t].parent_index]++;
+        }
+        for (uint16_t t = 0; t < n; t++) {
+            const KrbTemplateElement* te = &def->template_elements[t];
+            header_off[t] = wb->size;
+            write_element_header(wb, &te->header, child_counts[t]);
+            write_element_body(wb, &te->header, te->properties, te->custom_properties, te->state_properties, te->events,
+                               te->animation_refs);
+            refs_off[t] = wb->size;
+            for (uint16_t k = 0; k < child_counts[t]; k++) wb_u16(wb, 0);
+        }
+        bool ok = true;
+        for (uint16_t t = 1; t < n && ok; t++) {
+            uint16_t p = def->template_elements[t].parent_index;
+            if (p >= t) {
+                fprintf(stderr, "Error: Template element %u of component %u precedes its parent\n", t, i);
+                ok = false;
+                break;
+            }
+            ok = encode_child_ref(wb, refs_off[p], header_off[p], header_off[t]);
+            refs_off[p] += 2;
+        }
+        free(header_off); free(refs_off); free(child_counts);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static void write_animations(KrbWriteBuffer* wb, const KrbDocument* doc) {
+    for (uint16_t i = 0; i < doc->header.animation_count; i++) {
+        const KrbAnimation* anim = &doc->animations[i];
+        wb_index(wb, anim->name_index);
+        wb_u16(wb, anim->duration_ms);
+        wb_u8(wb, anim->easing);
+        wb_u8(wb, anim->flags);
+        wb_u8(wb, anim->track_count);
+        for (uint8_t t = 0; t < anim->track_count; t++) {
+            const KrbAnimationTrack* track = &anim->tracks[t];
+            wb_u8(wb, track->property_id);
+            wb_u8(wb, track->value_type);
+            wb_u8(wb, track->value_size);
+            wb_u8(wb, track->keyframe_count);
+            for (uint8_t k = 0; k < track->keyframe_count; k++) {
+                wb_u8(wb, track->keyframes[k].offset);
+                wb_put(wb, track->keyframes[k].value, track->value_size);
+            }
+        }
+    }
+}
+
+static void write_scripts(KrbWriteBuffer* wb, const KrbDocument* doc) {
+    wb_u16(wb, doc->header.script_count);
+    for (uint16_t i = 0; i < doc->header.script_count; i++) {
+        const KrbScript* script = &doc->scripts[i];
+        wb_u8(wb, script->language_id);
+        wb_index(wb, script->name_index);
+        wb_u8(wb, script->storage_format);
+        wb_u8(wb, script->entry_point_count);
+        // External scripts store their resource index in the DataSize field
+        bool is_inline = (script->storage_format == SCRIPT_STORAGE_INLINE);
+        wb_u16(wb, is_inline ? script->data_size : script->resource_index);
+        for (uint8_t j = 0; j < script->entry_point_count; j++) {
+            wb_index(wb, script->entry_points[j].function_name_index);
+        }
+        if (is_inline) wb_put(wb, script->code_data, script->data_size);
+    }
+}
+
+static bool write_strings(KrbWriteBuffer* wb, const KrbDocument* doc) {
+    wb_u16(wb, doc->header.string_count);
+    for (uint16_t i = 0; i < doc->header.string_count; i++) {
+        const char* str = doc->strings[i] ? doc->strings[i] : "";
+        size_t length = strlen(str);
+        if (length > UINT32_MAX) {
+            fprintf(stderr, "Error: String %u is %zu bytes; the format allows 4 GiB\n", i, length);
+            return false;
+        }
+        if (wb->wide) wb_varint(wb, (uint32_t)length);
+        else wb_u8(wb, (uint8_t)length);
+        wb_put(wb, str, length);
+    }
+    return true;
+}
+
+static bool write_resources(KrbWriteBuffer* wb, const KrbDocument* doc) {
+    wb_u16(wb, doc->header.resource_count);
+    for (uint16_t i = 0; i < doc->header.resource_count; i++) {
+        const KrbResource* res = &doc->resources[i];
+        wb_u8(wb, res->type);
+        wb_index(wb, res->name_index);
+        wb_u8(wb, res->format);
+        if (res->format == RES_FORMAT_INLINE) {
+            if (res->inline_data_size > 0xFFFF) {
+                fprintf(stderr, "Error: Inline resource %u is %zu bytes; the format allows 65535\n", i, res->inline_data_size);
+                return false;
+            }
+            wb_u16(wb, (uint16_t)res->inline_data_size);
+            wb_put(wb, res->inline_data, res->inline_data_size);
+        } else {
+            wb_index(wb, res->data_string_index);
+        }
+    }
+    return true;
+}
+
+// --- Format Revision ---
+
+static bool child_count_is_wide(const KrbDocument* doc) {
+    if (doc->element_first_child) {
+        for (uint16_t i = 0; i < doc->header.element_count; i++) {
+            uint16_t children = 0;
+            for (uint16_t c = doc->element_first_child[i]; c != KRB_INVALID_INDEX; c = doc->element_next_sibling[c]) {
+                if (++children > 0xFF) return true;
+            }
+        }
+    }
+    for (uint16_t i = 0; i < doc->header.component_def_count; i++) {
+        const KrbComponentDefinition* def = &doc->component_defs[i];
+        for (uint16_t t = 0; t < def->template_element_count; t++) {
+            if (def->template_elements[t].header.child_count > 0xFF) return true;
+        }
+    }
+    return false;
+}
+
+// v0.5 is written whenever the document fits in it, so small documents stay readable by
+// older readers; anything past a one-byte index or string length needs v0.6.
+static bool document_needs_wide_indices(const KrbDocument* doc) {
+    if (doc->header.string_count > 0x100 || doc->header.style_count > 0xFF) return true;
+    for (uint16_t i = 0; i < doc->header.style_count; i++) {
+        if (doc->styles[i].id > 0xFF) return true;
+    }
+    for (uint16_t i = 0; i < doc->header.string_count; i++) {
+        if (doc->strings[i] && strlen(doc->strings[i]) > 0xFF) return true;
+    }
+    return child_count_is_wide(doc);
+}
+
+// --- Public API ---
+
+// Serializes a document to a freshly allocated v0.5 image, or v0.6 when it outgrows one-byte
+// indices (caller frees *out_data).
+bool krb_write_document_to_buffer(KrbDocument* doc, uint8_t** out_data, size_t* out_size) {
+    if (!doc || !out_data || !out_size) return false;
+    *out_data = NULL;
+    *out_size = 0;
+
+    KrbWriteBuffer wb = {0};
+    KrbHeader h = doc->header;
+    wb.wide = document_needs_wide_indices(doc);
+    uint8_t minor = wb.wide ? KRB_WIDE_INDEX_MINOR : KRB_SPEC_VERSION_MINOR_COMPAT;
+
+    // Header placeholder, patched once the section offsets are known
+    uint8_t zero_header[54] = {0};
+    wb_put(&wb, zero_header, sizeof(zero_header));
+
+    bool ok = true;
+    uint32_t element_offset = 0, style_offset = 0, component_def_offset = 0;
+    uint32_t animation_offset = 0, script_offset = 0, string_offset = 0, resource_offset = 0;
+
+    if (h.element_count > 0) {
+        element_offset = (uint32_t)wb.size;
+        ok = write_elements(&wb, doc);
+    }
+    if (ok && h.style_count > 0) {
+        style_offset = (uint32_t)wb.size;
+        for (uint16_t i = 0; i < h.style_count; i++) {
+            const KrbStyle* style = &doc->styles[i];
+            wb_index(&wb, style->id);
+            wb_index(&wb, style->name_index);
+            wb_u8(&wb, style->property_count);
+            write_properties(&wb, style->properties, style->property_count);
+        }
+    }
+    if (ok && h.component_def_count > 0) {
+        component_def_offset = (uint32_t)wb.size;
+        ok = write_component_defs(&wb, doc);
+    }
+    if (ok && h.animation_count > 0) {
+        animation_offset = (uint32_t)wb.size;
+        write_animations(&wb, doc);
+    }
+    if (ok && h.script_count > 0) {
+        script_offset = (uint32_t)wb.size;
+        write_scripts(&wb, doc);
+    }
+    if (ok && h.string_count > 0) {
+        string_offset = (uint32_t)wb.size;
+        ok = write_strings(&wb, doc);
+    }
+    if (ok && h.resource_count > 0) {
+        resource_offset = (uint32_t)wb.size;
+        ok = write_resources(&wb, doc);
+    }
+    if (!ok || wb.failed) {
+        free(wb.data);
+        return false;
+    }
+
+    // Flags describe what was actually written; sections are never compressed on output
+    uint16_t flags = h.flags & ~(FLAG_HAS_STYLES | FLAG_HAS_COMPONENT_DEFS | FLAG_HAS_ANIMATIONS |
+                                 FLAG_HAS_RESOURCES | FLAG_COMPRESSED | FLAG_HAS_SCRIPTS);
+    if (h.style_count > 0) flags |= FLAG_HAS_STYLES;
+    if (h.component_def_count > 0) flags |= FLAG_HAS_COMPONENT_DEFS;
+    if (h.animation_count > 0) flags |= FLAG_HAS_ANIMATIONS;
+    if (h.resource_count > 0) flags |= FLAG_HAS_RESOURCES;
+    if (h.script_count > 0) flags |= FLAG_HAS_SCRIPTS;
+
+    memcpy(wb.data, "KRB1", 4);
+    wb_patch_u16(&wb, 4, (uint16_t)((minor << 8) | KRB_SPEC_VERSION_MAJOR));
+    wb_patch_u16(&wb, 6, flags);
+    wb_patch_u16(&wb, 8, h.element_count);
+    wb_patch_u16(&wb, 10, h.style_count);
+    wb_patch_u16(&wb, 12, h.component_def_count);
+    wb_patch_u16(&wb, 14, h.animation_count);
+    wb_patch_u16(&wb, 16, h.script_count);
+    wb_patch_u16(&wb, 18, h.string_count);
+    wb_patch_u16(&wb, 20, h.resource_count);
+    wb_patch_u32(&wb, 22, element_offset);
+    wb_patch_u32(&wb, 26, style_offset);
+    wb_patch_u32(&wb, 30, component_def_offset);
+    wb_patch_u32(&wb, 34, animation_offset);
+    wb_patch_u32(&wb, 38, script_offset);
+    wb_patch_u32(&wb, 42, string_offset);
+    wb_patch_u32(&wb, 46, resource_offset);
+    wb_patch_u32(&wb, 50, (uint32_t)wb.size);
+
+    *out_data = wb.data;
+    *out_size = wb.size;
+    return true;
+}
+
+#ifndef KRB_NO_STDIO
+// Writes a document to 'file' as a v0.5 or v0.6 KRB image (see krb_write_document_to_buffer).
+bool krb_write_document(KrbDocument* doc, FILE* file) {
+    if (!doc || !file) return false;
+    uint8_t* data = NULL;
+    size_t size = 0;
+    if (!krb_write_document_to_buffer(doc, &data, &size)) return false;
+
+    bool ok = fwrite(data, 1, size, file) == size;
+    if (!ok) perror("write KRB document");
+    free(data);
+    return ok;
+}
+#endif
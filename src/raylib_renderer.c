@@ -9,6 +9,8 @@
 #include "custom_components.h"
 #include "custom_tabbar.h"
 #include "renderer.h" 
+#include "animation.h"
+#include "event_dispatch.h"
 
 // --- Basic Definitions ---
 #define DEFAULT_WINDOW_WIDTH 800
@@ -19,7 +21,7 @@
 // --- Forward Declarations ---
 void initialize_render_element(RenderElement* el, KrbElementHeader* header, int index, RenderContext* ctx);
 bool expand_all_components(RenderContext* ctx, FILE* debug_file);
-bool expand_component_for_element(RenderContext* ctx, RenderElement* element, uint8_t component_name_index, FILE* debug_file);
+bool expand_component_for_element(RenderContext* ctx, RenderElement* element, uint16_t component_name_index, FILE* debug_file);
 void apply_property_inheritance(RenderContext* ctx, FILE* debug_file);
 void inherit_properties_recursive(RenderElement* el, RenderContext* ctx, FILE* debug_file);
 void find_root_elements(RenderContext* ctx, FILE* debug_file);
@@ -30,25 +32,23 @@ void load_all_textures(RenderContext* ctx, const char* base_dir, FILE* debug_fil
 void handle_window_resize(RenderContext* ctx);
 
 
-static bool g_cursor_set_this_frame = false;
-static int g_highest_cursor_priority = -1;
-
 // --- Component Instantiation Functions ---
 
 bool find_component_name_property(KrbCustomProperty* custom_props, uint8_t custom_prop_count, 
-                                 char** strings, uint8_t* out_component_index) {
-    if (!custom_props || !strings || !out_component_index) return false;
+                                 KrbDocument* doc, uint16_t* out_component_index) {
+    if (!custom_props || !doc || !out_component_index) return false;
+    
+    // Resolve "_componentName" once; each key is then an integer compare
+    KrbAtom component_name_key = krb_find_atom(doc, "_componentName");
+    if (component_name_key == KRB_INVALID_ATOM) return false;
     
     for (uint8_t i = 0; i < custom_prop_count; i++) {
         KrbCustomProperty* prop = &custom_props[i];
         
-        // Check if this property key is "_componentName"
-        if (prop->key_index < MAX_ELEMENTS && strings[prop->key_index] && 
-            strcmp(strings[prop->key_index], "_componentName") == 0) {
-            
+        if (krb_string_atom(doc, prop->key_index) == component_name_key) {
             // Value should be a string index pointing to the component name
-            if (prop->value_type == VAL_TYPE_STRING && prop->value_size == 1 && prop->value) {
-                *out_component_index = *(uint8_t*)prop->value;
+            if (prop->value_type == VAL_TYPE_STRING &&
+                krb_read_ref_value(prop->value, prop->value_size, out_component_index)) {
                 return true;
             }
         }
@@ -90,13 +90,14 @@ void apply_property_to_element(RenderElement* element, KrbProperty* prop, KrbDoc
             break;
         
         case PROP_ID_TEXT_CONTENT:
-            if (prop->value_type == VAL_TYPE_STRING && prop->size == 1) {
-                uint8_t idx = *(uint8_t*)prop->value;
-                if (idx < doc->header.string_count && doc->strings[idx]) {
-                    free(element->text);
-                    element->text = strdup(doc->strings[idx]);
+            if (prop->value_type == VAL_TYPE_STRING) {
+                uint16_t idx;
+                if (krb_read_ref_value(prop->value, prop->size, &idx) && idx < doc->header.string_count && doc->strings[idx]) {
+                    free(element->cold->text);
+                    element->cold->text = strdup(doc->strings[idx]);
+                    element->cold->measured_text = NULL; // The new string may reuse the old address
                     if (debug_file) {
-                        fprintf(debug_file, "    -> Applied text: '%s' to element\n", element->text);
+                        fprintf(debug_file, "    -> Applied text: '%s' to element\n", element->cold->text);
                     }
                 }
             }
@@ -109,8 +110,8 @@ void apply_property_to_element(RenderElement* element, KrbProperty* prop, KrbDoc
             break;
             
         case PROP_ID_IMAGE_SOURCE:
-            if (prop->value_type == VAL_TYPE_RESOURCE && prop->size == 1) {
-                element->resource_index = *(uint8_t*)prop->value;
+            if (prop->value_type == VAL_TYPE_RESOURCE) {
+                krb_read_ref_value(prop->value, prop->size, &element->cold->resource_index);
             }
             break;
             
@@ -124,6 +125,16 @@ void apply_property_to_element(RenderElement* element, KrbProperty* prop, KrbDoc
             }
             break;
 
+        case PROP_ID_OPACITY:
+            // BYTE is 0-255; PERCENTAGE is 8.8 fixed point where 256 is fully opaque
+            if (prop->value_type == VAL_TYPE_BYTE && prop->size == 1) {
+                element->opacity = *(uint8_t*)prop->value;
+            } else if (prop->value_type == VAL_TYPE_PERCENTAGE && prop->size == 2) {
+                uint16_t pct = krb_read_u16_le(prop->value);
+                element->opacity = (pct >= 256) ? 255 : (uint8_t)(pct * 255 / 256);
+            }
+            break;
+
         case PROP_ID_FONT_SIZE:
             if (prop->value_type == VAL_TYPE_SHORT && prop->size == 2) {
                 uint16_t font_size = krb_read_u16_le(prop->value);
@@ -139,6 +150,20 @@ void apply_property_to_element(RenderElement* element, KrbProperty* prop, KrbDoc
             break;
     }
 }
+
+// MeasureText() through the element's cached width. Only the default font is used, so the
+// key is the text pointer and scaled size; setting new text clears measured_text.
+static int measure_element_text(RenderElement* el, int scaled_font_size) {
+    RenderElementCold* cold = el->cold;
+    if (!cold->text || cold->text[0] == '\0') return 0;
+    if (cold->measured_text != cold->text || cold->measured_font_size != scaled_font_size) {
+        cold->measured_width = MeasureText(cold->text, scaled_font_size);
+        cold->measured_text = cold->text;
+        cold->measured_font_size = scaled_font_size;
+    }
+    return cold->measured_width;
+}
+
 void calculate_element_minimum_size(RenderElement* el, float scale_factor) {
     if (!el) return;
     
@@ -146,23 +171,23 @@ void calculate_element_minimum_size(RenderElement* el, float scale_factor) {
     bool should_inherit_parent_size = false;
     
     // Check if element should inherit parent size
-    if (el->header.type == ELEM_TYPE_CONTAINER || el->header.type == ELEM_TYPE_APP) {
-        bool has_grow = (el->header.layout & LAYOUT_GROW_BIT) != 0;
-        bool has_explicit_width = (el->header.width > 0);
-        bool has_explicit_height = (el->header.height > 0);
+    if (el->type == ELEM_TYPE_CONTAINER || el->type == ELEM_TYPE_APP) {
+        bool has_grow = (el->layout & LAYOUT_GROW_BIT) != 0;
+        bool has_explicit_width = (el->width > 0);
+        bool has_explicit_height = (el->height > 0);
         
         should_inherit_parent_size = has_grow || 
             ((!has_explicit_width || !has_explicit_height) && el->parent != NULL);
     }
     
     // Calculate intrinsic content size
-    if (el->header.type == ELEM_TYPE_TEXT && el->text && el->text[0] != '\0') {
+    if (el->type == ELEM_TYPE_TEXT && el->cold->text && el->cold->text[0] != '\0') {
         // CRITICAL FIX: Force proper text sizing with debugging
         float font_size = (el->font_size > 0) ? el->font_size : BASE_FONT_SIZE;
         int scaled_font_size = (int)(font_size * scale_factor);
         if (scaled_font_size < 1) scaled_font_size = 1;
         
-        int text_width_measured = MeasureText(el->text, scaled_font_size);
+        int text_width_measured = measure_element_text(el, scaled_font_size);
         min_w = text_width_measured + (int)(8 * scale_factor);
         min_h = scaled_font_size + (int)(8 * scale_factor);
         
@@ -171,42 +196,42 @@ void calculate_element_minimum_size(RenderElement* el, float scale_factor) {
         el->render_h = min_h;
         
         printf("TEXT SIZE DEBUG: '%s' font_size=%.1f scaled=%d measured_width=%d final_size=%dx%d\n", 
-               el->text, font_size, scaled_font_size, text_width_measured, min_w, min_h);
+               el->cold->text, font_size, scaled_font_size, text_width_measured, min_w, min_h);
         
         return; // Skip the normal size application logic for text
     }
-    else if (el->header.type == ELEM_TYPE_BUTTON && el->text && el->text[0] != '\0') {
+    else if (el->type == ELEM_TYPE_BUTTON && el->cold->text && el->cold->text[0] != '\0') {
         float font_size = (el->font_size > 0) ? el->font_size : BASE_FONT_SIZE;
         int scaled_font_size = (int)(font_size * scale_factor);
         if (scaled_font_size < 1) scaled_font_size = 1;
-        int text_width_measured = MeasureText(el->text, scaled_font_size);
+        int text_width_measured = measure_element_text(el, scaled_font_size);
         min_w = text_width_measured + (int)(16 * scale_factor);
         min_h = scaled_font_size + (int)(16 * scale_factor);
     }
-    else if (el->header.type == ELEM_TYPE_IMAGE && el->texture_loaded) {
-        min_w = (int)(el->texture.width * scale_factor);
-        min_h = (int)(el->texture.height * scale_factor);
+    else if (el->type == ELEM_TYPE_IMAGE && el->cold->texture_loaded) {
+        min_w = (int)(el->cold->texture.width * scale_factor);
+        min_h = (int)(el->cold->texture.height * scale_factor);
     }
     else if (should_inherit_parent_size && el->parent) {
         min_w = el->parent->render_w > 0 ? el->parent->render_w : (int)(100 * scale_factor);
         min_h = el->parent->render_h > 0 ? el->parent->render_h : (int)(100 * scale_factor);
     }
-    else if (el->header.type == ELEM_TYPE_CONTAINER || el->header.type == ELEM_TYPE_APP) {
+    else if (el->type == ELEM_TYPE_CONTAINER || el->type == ELEM_TYPE_APP) {
         min_w = (int)(100 * scale_factor);
         min_h = (int)(100 * scale_factor);
     }
     
     // Apply explicit sizes or use calculated values (for non-text elements)
-    if (el->header.width > 0) {
-        el->render_w = (int)(el->header.width * scale_factor);
+    if (el->width > 0) {
+        el->render_w = (int)(el->width * scale_factor);
     } else if (should_inherit_parent_size && el->parent) {
         el->render_w = el->parent->render_w;
     } else {
         el->render_w = min_w;
     }
     
-    if (el->header.height > 0) {
-        el->render_h = (int)(el->header.height * scale_factor);
+    if (el->height > 0) {
+        el->render_h = (int)(el->height * scale_factor);
     } else if (should_inherit_parent_size && el->parent) {
         el->render_h = el->parent->render_h;
     } else {
@@ -218,29 +243,53 @@ void calculate_element_minimum_size(RenderElement* el, float scale_factor) {
     if (el->render_h <= 0) el->render_h = 1;
 }
 
+bool append_child_element(RenderElement* parent, RenderElement* child) {
+    if (!parent || !child) return false;
+    if (parent->child_count == parent->child_capacity) {
+        int capacity = parent->child_capacity ? parent->child_capacity * 2 : 4;
+        RenderElement** grown = realloc(parent->children, capacity * sizeof(RenderElement*));
+        if (!grown) {
+            perror("realloc element children");
+            return false;
+        }
+        parent->children = grown;
+        parent->child_capacity = capacity;
+    }
+    parent->children[parent->child_count++] = child;
+    return true;
+}
+
+void set_element_header(RenderElement* el, const KrbElementHeader* header) {
+    el->cold->header = *header;
+    el->type = header->type;
+    el->layout = header->layout;
+    el->pos_x = header->pos_x;
+    el->pos_y = header->pos_y;
+    el->width = header->width;
+    el->height = header->height;
+}
+
 void initialize_render_element(RenderElement* el, KrbElementHeader* header, int index, RenderContext* ctx) {
-    el->header = *header;
+    // Context elements are bound to their side-table record at allocation
+    if (!el->cold && ctx) el->cold = &ctx->cold[el - ctx->elements];
+    memset(el->cold, 0, sizeof(RenderElementCold));
+    set_element_header(el, header);
     el->original_index = index;
-    el->text = NULL;
     el->bg_color = (Color){0, 0, 0, 0}; // Transparent
     el->fg_color = (Color){0, 0, 0, 0}; // Unset - will inherit
     el->border_color = (Color){0, 0, 0, 0}; // Transparent
     memset(el->border_widths, 0, 4);
     el->text_alignment = 0; // Will inherit
     el->parent = NULL;
+    el->children = NULL;
     el->child_count = 0;
-    el->texture_loaded = false;
-    el->resource_index = INVALID_RESOURCE_INDEX;
+    el->child_capacity = 0;
+    el->cold->resource_index = INVALID_RESOURCE_INDEX;
     el->is_placeholder = false;
-    el->is_component_instance = false;
-    el->component_instance = NULL;
-    el->custom_properties = NULL;
-    el->custom_prop_count = 0;
     el->is_visible = true; // Default visible
-    el->is_interactive = (header->type == ELEM_TYPE_BUTTON || header->type == ELEM_TYPE_INPUT);
+    el->opacity = 255; // Opaque
+    el->is_interactive = (el->type == ELEM_TYPE_BUTTON || el->type == ELEM_TYPE_INPUT);
     el->font_size = 0.0f; // Will inherit
-    
-    for(int k = 0; k < MAX_ELEMENTS; k++) el->children[k] = NULL;
     el->render_x = 0; el->render_y = 0; el->render_w = 0; el->render_h = 0;
 }
 
@@ -248,8 +297,8 @@ void process_app_element_properties(RenderElement* app_element, KrbDocument* doc
     if (!app_element || !doc || !ctx) return;
     
     // Apply App Style if present
-    if (app_element->header.style_id > 0 && app_element->header.style_id <= doc->header.style_count && doc->styles) {
-        int style_idx = app_element->header.style_id - 1; 
+    if (app_element->cold->header.style_id > 0 && app_element->cold->header.style_id <= doc->header.style_count && doc->styles) {
+        int style_idx = app_element->cold->header.style_id - 1; 
         KrbStyle* app_style = &doc->styles[style_idx];
         for(int j = 0; j < app_style->property_count; j++) { 
             apply_property_to_element(app_element, &app_style->properties[j], doc, debug_file);
@@ -257,28 +306,29 @@ void process_app_element_properties(RenderElement* app_element, KrbDocument* doc
     }
     
     // Apply App Direct Properties for window configuration
-    if (doc->properties && doc->properties[0]) {
-        for (int j = 0; j < app_element->header.property_count; j++) { 
-            KrbProperty* prop = &doc->properties[0][j]; 
+    KrbProperty* app_props = krb_get_element_properties(doc, 0);
+    if (app_props) {
+        for (int j = 0; j < app_element->cold->header.property_count; j++) { 
+            KrbProperty* prop = &app_props[j]; 
             if (!prop || !prop->value) continue; 
             
             switch (prop->property_id) {
                 case PROP_ID_WINDOW_WIDTH:
                     if (prop->value_type == VAL_TYPE_SHORT && prop->size == 2) { 
                         ctx->window_width = krb_read_u16_le(prop->value); 
-                        app_element->header.width = ctx->window_width; 
+                        app_element->width = ctx->window_width; 
                     }
                     break;
                 case PROP_ID_WINDOW_HEIGHT:
                     if (prop->value_type == VAL_TYPE_SHORT && prop->size == 2) { 
                         ctx->window_height = krb_read_u16_le(prop->value); 
-                        app_element->header.height = ctx->window_height; 
+                        app_element->height = ctx->window_height; 
                     }
                     break;
                 case PROP_ID_WINDOW_TITLE:
-                    if (prop->value_type == VAL_TYPE_STRING && prop->size == 1) { 
-                        uint8_t idx = *(uint8_t*)prop->value; 
-                        if (idx < doc->header.string_count && doc->strings[idx]) { 
+                    if (prop->value_type == VAL_TYPE_STRING) { 
+                        uint16_t idx;
+                        if (krb_read_ref_value(prop->value, prop->size, &idx) && idx < doc->header.string_count && doc->strings[idx]) { 
                             free(ctx->window_title); 
                             ctx->window_title = strdup(doc->strings[idx]); 
                         } 
@@ -308,69 +358,99 @@ void process_app_element_properties(RenderElement* app_element, KrbDocument* doc
     app_element->render_y = 0;
 }
 
+// True when a direct property will replace 'style_prop' anyway: same id, same encoding.
+// One bit test and one slot read against the element's property index.
+static bool style_property_overridden(const KrbProperty* props, uint8_t count, const KrbPropertyIndex* index,
+                                      const KrbProperty* style_prop) {
+    const KrbProperty* direct = krb_find_property(props, count, index, style_prop->property_id);
+    return direct && direct->value && direct->value_type == style_prop->value_type && direct->size == style_prop->size;
+}
+
 void apply_element_styling(RenderElement* el, KrbDocument* doc, RenderContext* ctx, FILE* debug_file) {
     if (!el || !doc || !ctx) return;
     
-    // Apply Style
-    if (el->header.style_id > 0 && el->header.style_id <= doc->header.style_count && doc->styles) {
-        int style_idx = el->header.style_id - 1; 
+    // Decode first (the document may be loaded lazily) so the direct property index is known
+    if (!krb_get_element(doc, el->original_index)) return;
+    KrbProperty* direct_props = doc->properties ? doc->properties[el->original_index] : NULL;
+    const KrbPropertyIndex* direct_index = doc->property_index ? &doc->property_index[el->original_index] : NULL;
+    
+    // Apply Style, skipping properties the element sets directly
+    if (el->cold->header.style_id > 0 && el->cold->header.style_id <= doc->header.style_count && doc->styles) {
+        int style_idx = el->cold->header.style_id - 1; 
         KrbStyle* style = &doc->styles[style_idx];
         for(int j = 0; j < style->property_count; j++) { 
+            if (style_property_overridden(direct_props, el->cold->header.property_count, direct_index, &style->properties[j])) continue;
             apply_property_to_element(el, &style->properties[j], doc, debug_file);
         }
     }
     
     // Apply Direct Properties
-    if (doc->properties && el->original_index < doc->header.element_count && doc->properties[el->original_index]) {
-        for (int j = 0; j < el->header.property_count; j++) { 
+    if (direct_props) {
+        for (int j = 0; j < el->cold->header.property_count; j++) { 
             apply_property_to_element(el, &doc->properties[el->original_index][j], doc, debug_file);
         }
     }
     
     // Copy custom properties if present
     if (doc->elements[el->original_index].custom_prop_count > 0 && doc->custom_properties && doc->custom_properties[el->original_index]) {
-        el->custom_prop_count = doc->elements[el->original_index].custom_prop_count;
-        el->custom_properties = calloc(el->custom_prop_count, sizeof(KrbCustomProperty));
-        if (el->custom_properties) {
-            for (uint8_t j = 0; j < el->custom_prop_count; j++) {
-                el->custom_properties[j] = doc->custom_properties[el->original_index][j];
+        el->cold->custom_prop_count = doc->elements[el->original_index].custom_prop_count;
+        el->cold->custom_properties = calloc(el->cold->custom_prop_count, sizeof(KrbCustomProperty));
+        if (el->cold->custom_properties) {
+            for (uint8_t j = 0; j < el->cold->custom_prop_count; j++) {
+                el->cold->custom_properties[j] = doc->custom_properties[el->original_index][j];
             }
         }
     }
 }
 
+// Template elements carry their own decoded property arrays instead of a document index
+static void apply_template_element_styling(RenderElement* el, KrbTemplateElement* te, KrbDocument* doc, FILE* debug_file) {
+    if (el->cold->header.style_id > 0 && el->cold->header.style_id <= doc->header.style_count && doc->styles) {
+        KrbStyle* style = &doc->styles[el->cold->header.style_id - 1];
+        for (int j = 0; j < style->property_count; j++) { 
+            if (style_property_overridden(te->properties, te->header.property_count, &te->property_index, &style->properties[j])) continue;
+            apply_property_to_element(el, &style->properties[j], doc, debug_file);
+        }
+    }
+    for (int j = 0; te->properties && j < te->header.property_count; j++) { 
+        apply_property_to_element(el, &te->properties[j], doc, debug_file);
+    }
+    if (te->header.custom_prop_count > 0 && te->custom_properties) {
+        el->cold->custom_properties = calloc(te->header.custom_prop_count, sizeof(KrbCustomProperty));
+        if (el->cold->custom_properties) {
+            el->cold->custom_prop_count = te->header.custom_prop_count;
+            memcpy(el->cold->custom_properties, te->custom_properties, el->cold->custom_prop_count * sizeof(KrbCustomProperty));
+        }
+    }
+    el->cold->state_properties = te->state_properties;
+    el->cold->state_prop_count = te->header.state_prop_count;
+}
+
 void build_element_tree(RenderContext* ctx, FILE* debug_file) {
     if (!ctx || !ctx->doc) return;
     
     fprintf(debug_file, "INFO: Building element tree...\n");
     
-    RenderElement* parent_stack[MAX_ELEMENTS]; 
-    int stack_top = -1;
-
+    // The reader already resolved the serialized child refs, so this is one linear pass
+    // that attaches each element's children in file order. Child arrays are sized exactly.
+    KrbDocument* doc = ctx->doc;
     for (int i = 0; i < ctx->original_element_count; i++) {
-        RenderElement* current_el = &ctx->elements[i];
-        
-        // Find parent based on child count structure
-        while (stack_top >= 0) { 
-            RenderElement* p = parent_stack[stack_top]; 
-            if (p->child_count >= p->header.child_count) 
-                stack_top--; 
-            else 
-                break; 
-        }
-        
-        // Set parent relationship
-        if (stack_top >= 0) { 
-            RenderElement* p = parent_stack[stack_top]; 
-            current_el->parent = p; 
-            if (p->child_count < MAX_ELEMENTS) 
-                p->children[p->child_count++] = current_el; 
+        RenderElement* parent = &ctx->elements[i];
+        int count = 0;
+        for (uint16_t c = doc->element_first_child[i]; c != KRB_INVALID_INDEX; c = doc->element_next_sibling[c]) count++;
+        if (count == 0) continue;
+        RenderElement** children = realloc(parent->children, count * sizeof(RenderElement*));
+        if (!children) {
+            perror("realloc element children");
+            continue;
         }
-        
-        // Push to stack if has children
-        if (current_el->header.child_count > 0) { 
-            if (stack_top + 1 < MAX_ELEMENTS) 
-                parent_stack[++stack_top] = current_el; 
+        parent->children = children;
+        parent->child_capacity = count;
+        parent->child_count = 0;
+        for (uint16_t c = doc->element_first_child[i]; c != KRB_INVALID_INDEX; c = doc->element_next_sibling[c]) {
+            RenderElement* child = &ctx->elements[c];
+            child->parent = parent;
+            parent->children[parent->child_count++] = child;
         }
     }
     
@@ -386,11 +466,11 @@ bool expand_all_components(RenderContext* ctx, FILE* debug_file) {
     for (int i = 0; i < ctx->original_element_count; i++) {
         RenderElement* element = &ctx->elements[i];
         
-        if (element->custom_prop_count > 0 && element->custom_properties) {
-            uint8_t component_name_index;
+        if (element->cold->custom_prop_count > 0 && element->cold->custom_properties) {
+            uint16_t component_name_index;
             
-            if (find_component_name_property(element->custom_properties, element->custom_prop_count,
-                                           ctx->doc->strings, &component_name_index)) {
+            if (find_component_name_property(element->cold->custom_properties, element->cold->custom_prop_count,
+                                           ctx->doc, &component_name_index)) {
                 
                 // Find and expand the component
                 if (!expand_component_for_element(ctx, element, component_name_index, debug_file)) {
@@ -405,16 +485,81 @@ bool expand_all_components(RenderContext* ctx, FILE* debug_file) {
     return true;
 }
 
-bool expand_component_for_element(RenderContext* ctx, RenderElement* element, uint8_t component_name_index, FILE* debug_file) {
+// Moves element storage (and its cold side table) to larger blocks and rebases every pointer
+// into it: parent and child links, instance placeholders/roots and the root list. Pointers
+// held elsewhere (callers, animation bindings) are not updated, so growth must happen
+// before they exist.
+static bool grow_render_elements(RenderContext* ctx, int count) {
+    int capacity = ctx->element_capacity ? ctx->element_capacity : 16;
+    while (capacity < count) capacity *= 2;
+    RenderElementCold* cold = realloc(ctx->cold, capacity * sizeof(RenderElementCold));
+    if (!cold) {
+        perror("realloc render element side table");
+        return false;
+    }
+    // The old side table is gone; rebind existing elements before anything else can fail
+    ctx->cold = cold;
+    for (int i = 0; i < ctx->element_capacity; i++) ctx->elements[i].cold = &cold[i];
+    uintptr_t old_base = (uintptr_t)ctx->elements;
+    RenderElement* grown = realloc(ctx->elements, capacity * sizeof(RenderElement));
+    if (!grown) {
+        perror("realloc render elements");
+        return false;
+    }
+    memset(grown + ctx->element_capacity, 0, (capacity - ctx->element_capacity) * sizeof(RenderElement));
+    memset(cold + ctx->element_capacity, 0, (capacity - ctx->element_capacity) * sizeof(RenderElementCold));
+    for (int i = ctx->element_capacity; i < capacity; i++) grown[i].opacity = 255;
+    for (int i = 0; i < capacity; i++) grown[i].cold = &cold[i];
+    ctx->elements = grown;
+    ctx->element_capacity = capacity;
+    if ((uintptr_t)grown == old_base) return true;
+
+#define REBASE(p) ((p) ? (RenderElement*)((uintptr_t)(p) - old_base + (uintptr_t)grown) : NULL)
+    for (int i = 0; i < ctx->element_count; i++) {
+        RenderElement* el = &grown[i];
+        el->parent = REBASE(el->parent);
+        for (int k = 0; k < el->child_count; k++) el->children[k] = REBASE(el->children[k]);
+    }
+    for (ComponentInstance* inst = ctx->instances; inst; inst = inst->next) {
+        inst->placeholder = REBASE(inst->placeholder);
+        inst->root = REBASE(inst->root);
+    }
+    for (int i = 0; i < ctx->root_count; i++) ctx->roots[i] = REBASE(ctx->roots[i]);
+#undef REBASE
+    return true;
+}
+
+// Component placeholders resolved against the document, so storage can be sized up front
+static int count_component_elements(KrbDocument* doc) {
+    int count = 0;
+    for (uint16_t i = 0; i < doc->header.element_count; i++) {
+        uint16_t name_index;
+        if (!doc->custom_properties || !doc->custom_properties[i] ||
+            !find_component_name_property(doc->custom_properties[i], doc->elements[i].custom_prop_count, doc, &name_index)) {
+            continue;
+        }
+        KrbAtom name = krb_string_atom(doc, name_index);
+        for (uint16_t d = 0; d < doc->header.component_def_count && name != KRB_INVALID_ATOM; d++) {
+            if (krb_string_atom(doc, doc->component_defs[d].name_index) == name) {
+                count += doc->component_defs[d].template_element_count;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+bool expand_component_for_element(RenderContext* ctx, RenderElement* element, uint16_t component_name_index, FILE* debug_file) {
     if (!ctx || !element || !ctx->doc) return false;
     
-    // For now, mark as placeholder and create a simple component instance
+    // The placeholder stays in the tree; the template is instantiated beneath it
     element->is_placeholder = true;
     
-    // Find the component definition
+    // Find the component definition (by atom, so duplicate name strings still match)
     KrbComponentDefinition* comp_def = NULL;
-    for (uint8_t i = 0; i < ctx->doc->header.component_def_count; i++) {
-        if (ctx->doc->component_defs[i].name_index == component_name_index) {
+    KrbAtom component_name = krb_string_atom(ctx->doc, component_name_index);
+    for (uint16_t i = 0; i < ctx->doc->header.component_def_count && component_name != KRB_INVALID_ATOM; i++) {
+        if (krb_string_atom(ctx->doc, ctx->doc->component_defs[i].name_index) == component_name) {
             comp_def = &ctx->doc->component_defs[i];
             break;
         }
@@ -425,37 +570,71 @@ bool expand_component_for_element(RenderContext* ctx, RenderElement* element, ui
         return false;
     }
     
-    // Create a simple component instance (simplified for now)
     ComponentInstance* instance = calloc(1, sizeof(ComponentInstance));
     if (!instance) return false;
     
     instance->definition_index = comp_def - ctx->doc->component_defs;
     instance->placeholder = element;
     
-    // Create a simple root element for the component
-    if (ctx->element_count >= MAX_ELEMENTS) {
+    if (comp_def->template_element_count == 0) {
+        free(instance);
+        return false;
+    }
+    if (ctx->element_count + comp_def->template_element_count > ctx->element_capacity) {
+        // Storage was sized from the document; growing moves it, so re-derive 'element'
+        ptrdiff_t element_index = element - ctx->elements;
+        if (!grow_render_elements(ctx, ctx->element_count + comp_def->template_element_count)) {
+            free(instance);
+            return false;
+        }
+        element = &ctx->elements[element_index];
+        instance->placeholder = element;
+    }
+    
+    // Instantiate the parsed template in pre-order; parents always precede their children,
+    // so each element can be attached to an already-created parent by index.
+    RenderElement** instantiated = calloc(comp_def->template_element_count, sizeof(RenderElement*));
+    if (!instantiated) {
         free(instance);
         return false;
     }
+    for (uint16_t t = 0; t < comp_def->template_element_count; t++) {
+        KrbTemplateElement* te = &comp_def->template_elements[t];
+        RenderElement* el = &ctx->elements[ctx->element_count++];
+        initialize_render_element(el, &te->header, -1, ctx);
+        apply_template_element_styling(el, te, ctx->doc, debug_file);
+        el->cold->is_component_instance = true;
+        el->cold->component_instance = instance;
+        instantiated[t] = el;
+        
+        if (t > 0) {
+            RenderElement* parent = instantiated[te->parent_index];
+            el->parent = parent;
+            append_child_element(parent, el);
+        }
+    }
+    RenderElement* component_root = instantiated[0];
+    free(instantiated);
     
-    RenderElement* component_root = &ctx->elements[ctx->element_count++];
-    initialize_render_element(component_root, &comp_def->root_template_header, -1, ctx);
-    component_root->is_component_instance = true;
-    component_root->component_instance = instance;
     component_root->parent = element->parent;
     
     // Copy properties from placeholder to component root
-    component_root->header.id = element->header.id;
-    component_root->header.pos_x = element->header.pos_x;
-    component_root->header.pos_y = element->header.pos_y;
-    component_root->header.width = element->header.width;
-    component_root->header.height = element->header.height;
-    component_root->header.layout = element->header.layout;
-    component_root->header.style_id = element->header.style_id;
+    component_root->cold->header.id = element->cold->header.id;
+    component_root->pos_x = element->pos_x;
+    component_root->pos_y = element->pos_y;
+    component_root->width = element->width;
+    component_root->height = element->height;
+    component_root->layout = element->layout;
+    component_root->cold->header.style_id = element->cold->header.style_id;
     
     instance->root = component_root;
-    element->children[0] = component_root;
-    element->child_count = 1;
+    // The instance replaces the placeholder's own children; they stay allocated but are no
+    // longer part of the tree (they keep their parent link, so they never become roots)
+    element->child_count = 0;
+    if (!append_child_element(element, component_root)) {
+        free(instance);
+        return false;
+    }
     
     // Add to context's instance list
     instance->next = ctx->instances;
@@ -491,7 +670,7 @@ void inherit_properties_recursive(RenderElement* el, RenderContext* ctx, FILE* d
     
     if (debug_file) {
         fprintf(debug_file, "INHERIT: Processing element %d (type=0x%02X)\n", 
-                el->original_index, el->header.type);
+                el->original_index, el->type);
     }
     
     // Set defaults based on element type and parent
@@ -500,7 +679,7 @@ void inherit_properties_recursive(RenderElement* el, RenderContext* ctx, FILE* d
     int default_text_alignment = 1; // Center
     
     // For text elements, be more aggressive with defaults
-    if (el->header.type == ELEM_TYPE_TEXT) {
+    if (el->type == ELEM_TYPE_TEXT) {
         default_fg = (Color){255, 255, 0, 255}; // Force yellow for visibility
         default_font_size = BASE_FONT_SIZE;
         default_text_alignment = 1; // Center
@@ -521,7 +700,7 @@ void inherit_properties_recursive(RenderElement* el, RenderContext* ctx, FILE* d
                         el->fg_color.r, el->fg_color.g, el->fg_color.b, el->fg_color.a);
             }
         } else {
-            el->fg_color = (el->header.type == ELEM_TYPE_TEXT) ? default_fg : ctx->default_fg;
+            el->fg_color = (el->type == ELEM_TYPE_TEXT) ? default_fg : ctx->default_fg;
             if (debug_file) {
                 fprintf(debug_file, "  SET DEFAULT fg_color: (%d,%d,%d,%d)\n",
                         el->fg_color.r, el->fg_color.g, el->fg_color.b, el->fg_color.a);
@@ -561,7 +740,7 @@ void inherit_properties_recursive(RenderElement* el, RenderContext* ctx, FILE* d
                 fprintf(debug_file, "  INHERITED text_alignment from parent: %d\n", el->text_alignment);
             }
         } else {
-            el->text_alignment = (el->header.type == ELEM_TYPE_TEXT) ? default_text_alignment : 0;
+            el->text_alignment = (el->type == ELEM_TYPE_TEXT) ? default_text_alignment : 0;
             if (debug_file) {
                 fprintf(debug_file, "  SET DEFAULT text_alignment: %d\n", el->text_alignment);
             }
@@ -573,7 +752,7 @@ void inherit_properties_recursive(RenderElement* el, RenderContext* ctx, FILE* d
     }
     
     // Special validation for text elements
-    if (el->header.type == ELEM_TYPE_TEXT) {
+    if (el->type == ELEM_TYPE_TEXT) {
         // Ensure minimum visible values
         if (el->fg_color.a < 50) {
             el->fg_color.a = 255;
@@ -622,14 +801,217 @@ void inherit_properties_recursive(RenderElement* el, RenderContext* ctx, FILE* d
     }
 }
 
+// --- State Properties ---
+
+static int count_state_flags(uint8_t flags) {
+    int count = 0;
+    for (; flags; flags &= (uint8_t)(flags - 1)) count++;
+    return count;
+}
+
+// Packs the bits of 'state' selected by 'mask' into a dense delta table index
+static int state_delta_index(uint8_t mask, uint8_t state) {
+    int index = 0, bit = 0;
+    for (int f = 0; f < 8; f++) {
+        if (!(mask & (1 << f))) continue;
+        if (state & (1 << f)) index |= 1 << bit;
+        bit++;
+    }
+    return index;
+}
+
+static uint8_t state_from_delta_index(uint8_t mask, int index) {
+    uint8_t state = 0;
+    int bit = 0;
+    for (int f = 0; f < 8; f++) {
+        if (!(mask & (1 << f))) continue;
+        if (index & (1 << bit)) state |= (uint8_t)(1 << f);
+        bit++;
+    }
+    return state;
+}
+
+// Only paint can change with state; anything that moves geometry would need a re-layout
+static uint8_t state_paint_field(uint8_t property_id) {
+    switch (property_id) {
+        case PROP_ID_BG_COLOR:     return STATE_PAINT_BG;
+        case PROP_ID_FG_COLOR:     return STATE_PAINT_FG;
+        case PROP_ID_BORDER_COLOR: return STATE_PAINT_BORDER;
+        case PROP_ID_OPACITY:      return STATE_PAINT_OPACITY;
+        default:                   return 0;
+    }
+}
+
+static Color brighten_color(Color color) {
+    color.r = (color.r < 200) ? color.r + 55 : 255;
+    color.g = (color.g < 200) ? color.g + 55 : 255;
+    color.b = (color.b < 200) ? color.b + 55 : 255;
+    return color;
+}
+
+static void store_paint(const RenderElement* el, uint8_t fields, StatePaintDelta* out) {
+    out->fields = fields;
+    out->opacity = el->opacity;
+    out->bg_color = el->bg_color;
+    out->fg_color = el->fg_color;
+    out->border_color = el->border_color;
+}
+
+static void load_paint(RenderElement* el, const StatePaintDelta* delta) {
+    if (delta->fields & STATE_PAINT_BG) el->bg_color = delta->bg_color;
+    if (delta->fields & STATE_PAINT_FG) el->fg_color = delta->fg_color;
+    if (delta->fields & STATE_PAINT_BORDER) el->border_color = delta->border_color;
+    if (delta->fields & STATE_PAINT_OPACITY) el->opacity = delta->opacity;
+}
+
+static bool same_color(Color a, Color b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+// Puts the saved base back into the fields 'applied' overrode. A field that no longer holds
+// the delta's value was written since (an animation, a restyle); that write is the new base.
+static void restore_paint(RenderElement* el, const StatePaintDelta* applied, const StatePaintDelta* saved) {
+    if ((applied->fields & STATE_PAINT_BG) && same_color(el->bg_color, applied->bg_color)) el->bg_color = saved->bg_color;
+    if ((applied->fields & STATE_PAINT_FG) && same_color(el->fg_color, applied->fg_color)) el->fg_color = saved->fg_color;
+    if ((applied->fields & STATE_PAINT_BORDER) && same_color(el->border_color, applied->border_color)) {
+        el->border_color = saved->border_color;
+    }
+    if ((applied->fields & STATE_PAINT_OPACITY) && el->opacity == applied->opacity) el->opacity = saved->opacity;
+}
+
+void update_element_state(RenderElement* el, uint8_t new_state, RenderContext* ctx, FILE* debug_file) {
+    if (!el || !el->cold || el->cold->current_state == new_state) return;
+    RenderElementCold* cold = el->cold;
+    uint8_t old_state = cold->current_state;
+    cold->current_state = new_state;
+    if (!cold->state_deltas) return;
+
+    const StatePaintDelta* from = &cold->state_deltas[state_delta_index(cold->state_mask, old_state)];
+    const StatePaintDelta* to = &cold->state_deltas[state_delta_index(cold->state_mask, new_state)];
+    if (from == to) return;
+
+    // Restore what the old delta covered, then save and cover what the new one overrides
+    restore_paint(el, from, &cold->saved_paint);
+    store_paint(el, to->fields, &cold->saved_paint);
+    load_paint(el, to);
+    if (from->fields || to->fields) damage_element(ctx, el);
+
+    if (debug_file) {
+        fprintf(debug_file, "DEBUG STATE: Element %d state 0x%02X -> 0x%02X\n", el->original_index, old_state, new_state);
+    }
+}
+
+void resolve_state_properties(RenderElement* el, RenderContext* ctx, FILE* debug_file) {
+    if (!el || !el->cold || !ctx || !ctx->doc) return;
+    RenderElementCold* cold = el->cold;
+    KrbDocument* doc = ctx->doc;
+
+    // Instantiated elements got their template's sets at expansion
+    if (!cold->state_properties && el->original_index >= 0 && el->original_index < ctx->original_element_count &&
+        krb_get_element(doc, (uint16_t)el->original_index) && doc->state_properties) {
+        cold->state_properties = doc->state_properties[el->original_index];
+        cold->state_prop_count = doc->elements[el->original_index].state_prop_count;
+    }
+
+    // Rebuilding starts from the base paint
+    uint8_t state = cold->current_state;
+    update_element_state(el, 0, NULL, NULL);
+    free(cold->state_deltas);
+    cold->state_deltas = NULL;
+    cold->state_mask = 0;
+
+    uint8_t mask = 0;
+    for (uint8_t j = 0; cold->state_properties && j < cold->state_prop_count; j++) {
+        const KrbStatePropertySet* set = &cold->state_properties[j];
+        mask |= set->state_flags;
+        for (uint8_t p = 0; debug_file && p < set->property_count; p++) {
+            if (!state_paint_field(set->properties[p].property_id)) {
+                fprintf(debug_file, "WARN: Element %d state 0x%02X sets property 0x%02X, which only paint may change; ignored\n",
+                        el->original_index, set->state_flags, set->properties[p].property_id);
+            }
+        }
+    }
+    bool default_hover = el->type == ELEM_TYPE_BUTTON && !(mask & STATE_HOVER);
+    if (default_hover) mask |= STATE_HOVER;
+    if (mask == 0) {
+        cold->current_state = state;
+        return;
+    }
+
+    int count = 1 << count_state_flags(mask);
+    StatePaintDelta* deltas = calloc(count, sizeof(StatePaintDelta));
+    if (!deltas) {
+        perror("calloc state deltas");
+        cold->current_state = state;
+        return;
+    }
+    for (int i = 1; i < count; i++) {
+        uint8_t combination = state_from_delta_index(mask, i);
+        RenderElement resolved = *el; // Paint properties only write the hot fields
+        uint8_t fields = 0;
+        if (default_hover && (combination & STATE_HOVER)) {
+            resolved.bg_color = brighten_color(el->bg_color);
+            resolved.border_color = brighten_color(el->border_color);
+            fields |= STATE_PAINT_BG | STATE_PAINT_BORDER;
+        }
+        // Every set whose states are all active applies; more specific sets win, then later ones
+        for (int specificity = 1; specificity <= 8; specificity++) {
+            for (uint8_t j = 0; cold->state_properties && j < cold->state_prop_count; j++) {
+                const KrbStatePropertySet* set = &cold->state_properties[j];
+                if (!set->state_flags || (set->state_flags & ~combination) ||
+                    count_state_flags(set->state_flags) != specificity) continue;
+                for (uint8_t p = 0; set->properties && p < set->property_count; p++) {
+                    uint8_t field = state_paint_field(set->properties[p].property_id);
+                    if (!field) continue;
+                    apply_property_to_element(&resolved, &set->properties[p], doc, NULL);
+                    fields |= field;
+                }
+            }
+        }
+        store_paint(&resolved, fields, &deltas[i]);
+    }
+    cold->state_mask = mask;
+    cold->state_deltas = deltas;
+    update_element_state(el, state, ctx, debug_file);
+}
+
+void resolve_all_state_properties(RenderContext* ctx, FILE* debug_file) {
+    if (!ctx) return;
+    int resolved = 0;
+    for (int i = 0; i < ctx->element_count; i++) {
+        resolve_state_properties(&ctx->elements[i], ctx, debug_file);
+        if (ctx->elements[i].cold->state_deltas) resolved++;
+    }
+    if (debug_file) {
+        fprintf(debug_file, "INFO: Precomputed state paint for %d elements\n", resolved);
+    }
+}
+
+Color resolve_state_color_property(RenderElement* el, uint8_t base_prop_id, Color base_color) {
+    if (!el || !el->cold || !el->cold->state_deltas) return base_color;
+    const StatePaintDelta* delta = &el->cold->state_deltas[state_delta_index(el->cold->state_mask, el->cold->current_state)];
+    switch (base_prop_id) {
+        case PROP_ID_BG_COLOR:     return (delta->fields & STATE_PAINT_BG) ? delta->bg_color : base_color;
+        case PROP_ID_FG_COLOR:     return (delta->fields & STATE_PAINT_FG) ? delta->fg_color : base_color;
+        case PROP_ID_BORDER_COLOR: return (delta->fields & STATE_PAINT_BORDER) ? delta->border_color : base_color;
+        default:                   return base_color;
+    }
+}
+
 void find_root_elements(RenderContext* ctx, FILE* debug_file) {
     if (!ctx) return;
     
     ctx->root_count = 0;
+    RenderElement** roots = realloc(ctx->roots, (ctx->element_count ? ctx->element_count : 1) * sizeof(RenderElement*));
+    if (!roots) {
+        perror("realloc root elements");
+        return;
+    }
+    ctx->roots = roots;
     
     for (int i = 0; i < ctx->element_count; i++) {
         RenderElement* el = &ctx->elements[i];
-        if (!el->parent && !el->is_placeholder && ctx->root_count < MAX_ELEMENTS) {
+        if (!el->parent && !el->is_placeholder) {
             ctx->roots[ctx->root_count++] = el;
         }
     }
@@ -644,12 +1026,12 @@ void load_all_textures(RenderContext* ctx, const char* base_dir, FILE* debug_fil
     
     for (int i = 0; i < ctx->element_count; i++) {
         RenderElement* el = &ctx->elements[i];
-        if (el->header.type == ELEM_TYPE_IMAGE && el->resource_index != INVALID_RESOURCE_INDEX) {
-            if (el->resource_index >= ctx->doc->header.resource_count || !ctx->doc->resources) { 
+        if (el->type == ELEM_TYPE_IMAGE && el->cold->resource_index != INVALID_RESOURCE_INDEX) {
+            if (el->cold->resource_index >= ctx->doc->header.resource_count || !ctx->doc->resources) { 
                 continue; 
             }
             
-            KrbResource* res = &ctx->doc->resources[el->resource_index];
+            KrbResource* res = &ctx->doc->resources[el->cold->resource_index];
             if (res->format == RES_FORMAT_EXTERNAL) {
                 if (res->data_string_index >= ctx->doc->header.string_count || !ctx->doc->strings || !ctx->doc->strings[res->data_string_index]) { 
                     continue; 
@@ -659,14 +1041,30 @@ void load_all_textures(RenderContext* ctx, const char* base_dir, FILE* debug_fil
                 char full_path[512];
                 snprintf(full_path, sizeof(full_path), "%s/%s", base_dir, relative_path);
                 
-                el->texture = LoadTexture(full_path);
-                if (IsTextureReady(el->texture)) {
-                    el->texture_loaded = true;
+                el->cold->texture = LoadTexture(full_path);
+                if (IsTextureReady(el->cold->texture)) {
+                    el->cold->texture_loaded = true;
                     fprintf(debug_file, "  Loaded texture: %s\n", full_path);
                 } else {
                     fprintf(debug_file, "  Failed to load texture: %s\n", full_path);
-                    el->texture_loaded = false;
+                    el->cold->texture_loaded = false;
+                }
+            } else if (res->format == RES_FORMAT_INLINE && res->inline_data && res->inline_data_size > 0) {
+                // Decode straight from the loaded/mapped document; raylib picks the codec by extension
+                const char* name = (res->name_index < ctx->doc->header.string_count && ctx->doc->strings)
+                                   ? ctx->doc->strings[res->name_index] : NULL;
+                const char* ext = name ? strrchr(name, '.') : NULL;
+                if (!ext) ext = ".png";
+
+                Image image = LoadImageFromMemory(ext, res->inline_data, (int)res->inline_data_size);
+                if (IsImageReady(image)) {
+                    el->cold->texture = LoadTextureFromImage(image);
+                    el->cold->texture_loaded = IsTextureReady(el->cold->texture);
+                    UnloadImage(image);
                 }
+                fprintf(debug_file, "  %s inline texture: %s (%zu bytes)\n",
+                        el->cold->texture_loaded ? "Loaded" : "Failed to load",
+                        name ? name : "<unnamed>", res->inline_data_size);
             }
         }
     }
@@ -680,10 +1078,11 @@ void handle_window_resize(RenderContext* ctx) {
         ctx->window_height = GetScreenHeight(); 
         
         // Update app element size if it exists
-        if (ctx->element_count > 0 && ctx->elements[0].header.type == ELEM_TYPE_APP) {
+        if (ctx->element_count > 0 && ctx->elements[0].type == ELEM_TYPE_APP) {
             ctx->elements[0].render_w = ctx->window_width; 
             ctx->elements[0].render_h = ctx->window_height; 
         }
+        ctx->layout_dirty = true;
     }
 }
 
@@ -699,12 +1098,22 @@ RenderContext* create_render_context(KrbDocument* doc, FILE* debug_file) {
     ctx->instances = NULL;
     ctx->root_count = 0;
     
-    // Allocate elements array with extra space for component expansion
-    ctx->elements = calloc(MAX_ELEMENTS, sizeof(RenderElement));
-    if (!ctx->elements) {
+    // Sized for the document plus every component it instantiates, so expansion never moves it
+    ctx->element_capacity = doc->header.element_count + count_component_elements(doc);
+    if (ctx->element_capacity == 0) ctx->element_capacity = 1;
+    ctx->elements = calloc(ctx->element_capacity, sizeof(RenderElement));
+    ctx->cold = calloc(ctx->element_capacity, sizeof(RenderElementCold));
+    if (!ctx->elements || !ctx->cold) {
+        free(ctx->elements);
+        free(ctx->cold);
         free(ctx);
         return NULL;
     }
+    // Opaque by default, also for callers that fill elements in without initialize_render_element
+    for (int i = 0; i < ctx->element_capacity; i++) {
+        ctx->elements[i].opacity = 255;
+        ctx->elements[i].cold = &ctx->cold[i];
+    }
     
     // Set defaults
     ctx->default_bg = BLACK;
@@ -715,6 +1124,9 @@ RenderContext* create_render_context(KrbDocument* doc, FILE* debug_file) {
     ctx->scale_factor = DEFAULT_SCALE_FACTOR;
     ctx->window_title = NULL;
     ctx->resizable = false;
+    ctx->layout_dirty = true;
+    ctx->paint_dirty = true;
+    ctx->full_damage = true;
     
     if (debug_file) {
         fprintf(debug_file, "INFO: Created render context with %d elements\n", ctx->element_count);
@@ -728,15 +1140,17 @@ void free_render_context(RenderContext* ctx) {
     
     // Free element text strings and custom properties
     for (int i = 0; i < ctx->element_count; i++) {
-        if (ctx->elements[i].text) {
-            free(ctx->elements[i].text);
-            ctx->elements[i].text = NULL;
+        if (ctx->elements[i].cold->text) {
+            free(ctx->elements[i].cold->text);
+            ctx->elements[i].cold->text = NULL;
         }
         
-        if (ctx->elements[i].custom_properties) {
-            free(ctx->elements[i].custom_properties);
-            ctx->elements[i].custom_properties = NULL;
+        if (ctx->elements[i].cold->custom_properties) {
+            free(ctx->elements[i].cold->custom_properties);
+            ctx->elements[i].cold->custom_properties = NULL;
         }
+        free(ctx->elements[i].cold->state_deltas);
+        free(ctx->elements[i].children);
     }
     
     // Free component instances
@@ -749,6 +1163,10 @@ void free_render_context(RenderContext* ctx) {
     
     // Free the main elements array
     free(ctx->elements);
+    free(ctx->cold);
+    free(ctx->roots);
+    free_draw_list(&ctx->draw_list);
+    free_hit_grid(&ctx->hit_grid);
     
     // Free window title
     if (ctx->window_title) {
@@ -763,7 +1181,7 @@ void apply_contextual_defaults(RenderElement* el, RenderContext* ctx, FILE* debu
     
     if (debug_file) {
         fprintf(debug_file, "CONTEXTUAL DEFAULTS: Element %d (type=0x%02X)\n", 
-                el->original_index, el->header.type);
+                el->original_index, el->type);
     }
     
     // Check border color and width relationship (per Section 3 of spec)
@@ -794,99 +1212,98 @@ void apply_contextual_defaults(RenderElement* el, RenderContext* ctx, FILE* debu
     }
 }
 
-void reset_cursor_for_frame(void) {
-    g_cursor_set_this_frame = false;
-    g_highest_cursor_priority = -1;
+// Scales a color's alpha by an element's opacity
+static Color apply_opacity(Color color, uint8_t opacity) {
+    color.a = (uint8_t)((color.a * opacity) / 255);
+    return color;
 }
 
-void render_element(RenderElement* el, int parent_content_x, int parent_content_y, int parent_content_width, int parent_content_height, float scale_factor, FILE* debug_file) {
-    if (!el) return;
-
-    // Skip rendering placeholder elements
-    if (el->is_placeholder) {
-        if (debug_file) {
-            fprintf(debug_file, "DEBUG RENDER: Skipping placeholder element %d\n", el->original_index);
-        }
-        return;
-    }
-
-    // Skip rendering invisible elements
-    if (!el->is_visible) {
-        if (debug_file) {
-            fprintf(debug_file, "DEBUG RENDER: Skipping invisible element %d\n", el->original_index);
-        }
-        return;
-    }
-
-    // Check if element already has pre-calculated size (from custom components)
-    bool has_precalculated_size = (el->render_w > 0 && el->render_h > 0);
-    
-    int intrinsic_w, intrinsic_h;
-    
-    if (has_precalculated_size) {
-        // Use pre-calculated size from custom components
-        intrinsic_w = el->render_w;
-        intrinsic_h = el->render_h;
-        if (debug_file) {
-            fprintf(debug_file, "DEBUG RENDER: Using pre-calculated size for Elem %d: %dx%d\n", 
-                    el->original_index, intrinsic_w, intrinsic_h);
-        }
+// Size an element takes before its parent places it: the size custom components or
+// calculate_element_minimum_size() left in render_w/h, otherwise its header size grown to
+// fit its text or texture
+static void element_intrinsic_size(RenderElement* el, float scale_factor, int* out_w, int* out_h) {
+    int w, h;
+    if (el->render_w > 0 && el->render_h > 0) {
+        w = el->render_w;
+        h = el->render_h;
     } else {
-        // --- Calculate Intrinsic Size ---
-        intrinsic_w = (int)(el->header.width * scale_factor);
-        intrinsic_h = (int)(el->header.height * scale_factor);
-        
-        if (el->header.type == ELEM_TYPE_TEXT && el->text) {
-                // CRITICAL FIX: Ensure font size is never 0
-                float font_size = (el->font_size > 0) ? el->font_size : BASE_FONT_SIZE;
-                int scaled_font_size = (int)(font_size * scale_factor);
-                if (scaled_font_size < 1) scaled_font_size = 1;
-                int text_width_measured = (el->text[0] != '\0') ? MeasureText(el->text, scaled_font_size) : 0;
-                if (el->header.width == 0) intrinsic_w = text_width_measured + (int)(8 * scale_factor);
-                if (el->header.height == 0) intrinsic_h = scaled_font_size + (int)(8 * scale_factor);
-                
-                // Debug output
-                if (debug_file) {
-                    fprintf(debug_file, "  TEXT SIZE CALC: font_size=%.1f scaled=%d measured=%d intrinsic=%dx%d\n",
-                            font_size, scaled_font_size, text_width_measured, intrinsic_w, intrinsic_h);
-                }
-            }
-        else if (el->header.type == ELEM_TYPE_BUTTON && el->text) {
+        w = (int)(el->width * scale_factor);
+        h = (int)(el->height * scale_factor);
+
+        if ((el->type == ELEM_TYPE_TEXT || el->type == ELEM_TYPE_BUTTON) && el->cold->text) {
+            // Buttons get twice the text padding
+            int padding = (el->type == ELEM_TYPE_BUTTON) ? 16 : 8;
             float font_size = (el->font_size > 0) ? el->font_size : BASE_FONT_SIZE;
             int scaled_font_size = (int)(font_size * scale_factor);
             if (scaled_font_size < 1) scaled_font_size = 1;
-            int text_width_measured = (el->text[0] != '\0') ? MeasureText(el->text, scaled_font_size) : 0;
-            if (el->header.width == 0) intrinsic_w = text_width_measured + (int)(16 * scale_factor);
-            if (el->header.height == 0) intrinsic_h = scaled_font_size + (int)(16 * scale_factor);
+            int text_width_measured = measure_element_text(el, scaled_font_size);
+            if (el->width == 0) w = text_width_measured + (int)(padding * scale_factor);
+            if (el->height == 0) h = scaled_font_size + (int)(padding * scale_factor);
         }
-        else if (el->header.type == ELEM_TYPE_IMAGE && el->texture_loaded) {
-            if (el->header.width == 0) intrinsic_w = (int)(el->texture.width * scale_factor);
-            if (el->header.height == 0) intrinsic_h = (int)(el->texture.height * scale_factor);
+        else if (el->type == ELEM_TYPE_IMAGE && el->cold->texture_loaded) {
+            if (el->width == 0) w = (int)(el->cold->texture.width * scale_factor);
+            if (el->height == 0) h = (int)(el->cold->texture.height * scale_factor);
         }
+    }
 
-        // Clamp minimum size
-        if (intrinsic_w < 0) intrinsic_w = 0;
-        if (intrinsic_h < 0) intrinsic_h = 0;
-        if (el->header.width > 0 && intrinsic_w == 0) intrinsic_w = 1;
-        if (el->header.height > 0 && intrinsic_h == 0) intrinsic_h = 1;
+    // Clamp minimum size
+    if (w < 0) w = 0;
+    if (h < 0) h = 0;
+    if (el->width > 0 && w == 0) w = 1;
+    if (el->height > 0 && h == 0) h = 1;
+    *out_w = w;
+    *out_h = h;
+}
+
+// Scaled border widths (top, right, bottom, left), clamped so they never exceed the element
+static void element_border_widths(const RenderElement* el, float scale_factor, int bw[4]) {
+    for (int i = 0; i < 4; i++) bw[i] = (int)(el->border_widths[i] * scale_factor);
+
+    if (el->render_h > 0 && bw[0] + bw[2] >= el->render_h) {
+        bw[0] = el->render_h > 1 ? 1 : el->render_h;
+        bw[2] = 0;
     }
+    if (el->render_w > 0 && bw[3] + bw[1] >= el->render_w) {
+        bw[3] = el->render_w > 1 ? 1 : el->render_w;
+        bw[1] = 0;
+    }
+}
+
+// Area inside the borders, where children are laid out and text/images are drawn
+static Rectangle element_content_rect(const RenderElement* el, float scale_factor) {
+    int bw[4];
+    element_border_widths(el, scale_factor, bw);
+    int content_width = el->render_w - bw[3] - bw[1];
+    int content_height = el->render_h - bw[0] - bw[2];
+    if (content_width < 0) content_width = 0;
+    if (content_height < 0) content_height = 0;
+    return (Rectangle){ (float)(el->render_x + bw[3]), (float)(el->render_y + bw[0]),
+                        (float)content_width, (float)content_height };
+}
+
+void layout_element(RenderElement* el, int parent_content_x, int parent_content_y, int parent_content_width, int parent_content_height, float scale_factor, FILE* debug_file) {
+    if (!el || el->is_placeholder || !el->is_visible) return;
+    (void)parent_content_width;
+    (void)parent_content_height;
+
+    // Check if element already has pre-calculated size (from custom components)
+    bool has_precalculated_size = (el->render_w > 0 && el->render_h > 0);
+    int final_w, final_h;
+    element_intrinsic_size(el, scale_factor, &final_w, &final_h);
 
-    // --- Determine Final Position & Size (Layout) ---
+    // --- Determine Final Position ---
     int final_x, final_y;
-    int final_w = intrinsic_w;
-    int final_h = intrinsic_h;
-    bool has_pos = (el->header.pos_x != 0 || el->header.pos_y != 0);
-    bool is_absolute = (el->header.layout & LAYOUT_ABSOLUTE_BIT);
+    bool has_pos = (el->pos_x != 0 || el->pos_y != 0);
+    bool is_absolute = (el->layout & LAYOUT_ABSOLUTE_BIT);
 
-    // Position calculation
     if (has_precalculated_size && el->render_x != 0 && el->render_y != 0) {
         // Use pre-calculated position from custom components
         final_x = el->render_x;
         final_y = el->render_y;
     } else if (is_absolute || has_pos) {
         // Absolute positioning
-        final_x = parent_content_x + (int)(el->header.pos_x * scale_factor);
-        final_y = parent_content_y + (int)(el->header.pos_y * scale_factor);
+        final_x = parent_content_x + (int)(el->pos_x * scale_factor);
+        final_y = parent_content_y + (int)(el->pos_y * scale_factor);
     } else if (el->parent != NULL) {
         // Flow layout - position determined by parent's layout logic
         final_x = el->render_x;
@@ -897,109 +1314,229 @@ void render_element(RenderElement* el, int parent_content_x, int parent_content_
         final_y = parent_content_y;
     }
 
-    // Store final calculated render coordinates
     el->render_x = final_x;
     el->render_y = final_y;
     el->render_w = final_w;
     el->render_h = final_h;
 
-    // --- Check for mouse hover (for interactive elements) ---
-    bool is_hovered = false;
-    if (el->is_interactive) {
-        Vector2 mouse_pos = GetMousePosition();
-        is_hovered = (mouse_pos.x >= el->render_x && mouse_pos.x < el->render_x + el->render_w &&
-                     mouse_pos.y >= el->render_y && mouse_pos.y < el->render_y + el->render_h);
-        
-        // Set cursor for interactive elements with priority system
-        if (is_hovered) {
-            int cursor_priority = 100; // Interactive elements get high priority
-            
-            // Only set cursor if this element has higher or equal priority to current
-            if (!g_cursor_set_this_frame || cursor_priority >= g_highest_cursor_priority) {
-                SetMouseCursor(MOUSE_CURSOR_POINTING_HAND);
-                g_cursor_set_this_frame = true;
-                g_highest_cursor_priority = cursor_priority;
+    if (debug_file) {
+        fprintf(debug_file, "DEBUG LAYOUT: Elem %d (Type=0x%02X) @(%d,%d) Size=%dx%d Layout=0x%02X\n",
+                el->original_index, el->type, el->render_x, el->render_y, el->render_w, el->render_h,
+                el->layout);
+    }
+
+    Rectangle content = element_content_rect(el, scale_factor);
+    int content_x = (int)content.x;
+    int content_y = (int)content.y;
+    int content_width = (int)content.width;
+    int content_height = (int)content.height;
+    if (el->child_count == 0 || content_width <= 0 || content_height <= 0) return;
+
+    uint8_t direction = el->layout & LAYOUT_DIRECTION_MASK;
+    uint8_t alignment = (el->layout & LAYOUT_ALIGNMENT_MASK) >> 2;
+    int current_flow_x = content_x;
+    int current_flow_y = content_y;
+    int total_child_width_scaled = 0;
+    int total_child_height_scaled = 0;
+    int flow_child_count = 0;
+
+    if (debug_file) fprintf(debug_file, "  Layout Children of Elem %d: Count=%d Dir=%d Align=%d Content=(%d,%d %dx%d)\n",
+                           el->original_index, el->child_count, direction, alignment, content_x, content_y, content_width, content_height);
+
+    // Pass 1: Calculate sizes and total dimensions of flow children
+    for (int i = 0; i < el->child_count; i++) {
+        RenderElement* child = el->children[i];
+        if (!child || child->is_placeholder || !child->is_visible) continue;
+
+        bool child_is_absolute = (child->layout & LAYOUT_ABSOLUTE_BIT);
+        bool child_has_pos = (child->pos_x != 0 || child->pos_y != 0);
+        if (child_is_absolute || child_has_pos) continue;
+
+        int child_w, child_h;
+        element_intrinsic_size(child, scale_factor, &child_w, &child_h);
+
+        if (direction == 0x00 || direction == 0x02) {
+            total_child_width_scaled += child_w;
+        } else {
+            total_child_height_scaled += child_h;
+        }
+        flow_child_count++;
+    }
+
+    // Pass 2: Calculate starting position based on alignment
+    if (direction == 0x00 || direction == 0x02) {
+        if (alignment == 0x01) {
+            current_flow_x = content_x + (content_width - total_child_width_scaled) / 2;
+        } else if (alignment == 0x02) {
+            current_flow_x = content_x + content_width - total_child_width_scaled;
+        }
+        if (current_flow_x < content_x) current_flow_x = content_x;
+    } else {
+        if (alignment == 0x01) {
+            current_flow_y = content_y + (content_height - total_child_height_scaled) / 2;
+        } else if (alignment == 0x02) {
+            current_flow_y = content_y + content_height - total_child_height_scaled;
+        }
+        if (current_flow_y < content_y) current_flow_y = content_y;
+    }
+
+    // Calculate spacing for SpaceBetween
+    float space_between = 0;
+    if (alignment == 0x03 && flow_child_count > 1) {
+        if (direction == 0x00 || direction == 0x02) {
+            space_between = (float)(content_width - total_child_width_scaled) / (flow_child_count - 1);
+        } else {
+            space_between = (float)(content_height - total_child_height_scaled) / (flow_child_count - 1);
+        }
+        if (space_between < 0) space_between = 0;
+    }
+
+    // Pass 3: Position children and lay out their subtrees
+    int flow_children_processed = 0;
+    for (int i = 0; i < el->child_count; i++) {
+        RenderElement* child = el->children[i];
+        if (!child || child->is_placeholder || !child->is_visible) continue;
+
+        bool child_is_absolute = (child->layout & LAYOUT_ABSOLUTE_BIT);
+        bool child_has_pos = (child->pos_x != 0 || child->pos_y != 0);
+
+        if (child_is_absolute || child_has_pos) {
+            layout_element(child, content_x, content_y, content_width, content_height, scale_factor, debug_file);
+            continue;
+        }
+
+        // Pass 1 measured this child already and nothing has touched it since; measuring again
+        // (text widths are cached) keeps layout free of arrays sized by the child count
+        int child_w, child_h;
+        element_intrinsic_size(child, scale_factor, &child_w, &child_h);
+        int child_final_x, child_final_y;
+
+        if (direction == 0x00 || direction == 0x02) {
+            child_final_x = current_flow_x;
+            if (alignment == 0x01) child_final_y = content_y + (content_height - child_h) / 2;
+            else if (alignment == 0x02) child_final_y = content_y + content_height - child_h;
+            else child_final_y = content_y;
+        } else {
+            child_final_y = current_flow_y;
+            if (alignment == 0x01) child_final_x = content_x + (content_width - child_w) / 2;
+            else if (alignment == 0x02) child_final_x = content_x + content_width - child_w;
+            else child_final_x = content_x;
+        }
+
+        child->render_x = child_final_x;
+        child->render_y = child_final_y;
+
+        layout_element(child, content_x, content_y, content_width, content_height, scale_factor, debug_file);
+
+        if (direction == 0x00 || direction == 0x02) {
+            current_flow_x += child_w;
+            if (alignment == 0x03 && flow_children_processed < flow_child_count - 1) {
+                current_flow_x += (int)roundf(space_between);
+            }
+        } else {
+            current_flow_y += child_h;
+            if (alignment == 0x03 && flow_children_processed < flow_child_count - 1) {
+                current_flow_y += (int)roundf(space_between);
             }
         }
+        flow_children_processed++;
     }
+}
 
-    // --- Apply Styling (with hover effects) ---
-    Color bg_color = el->bg_color;
-    Color fg_color = el->fg_color;
-    Color border_color = el->border_color;
-    
-    // Apply hover effects for buttons
-    if (el->header.type == ELEM_TYPE_BUTTON && is_hovered) {
-        // Brighten background on hover
-        bg_color.r = (bg_color.r < 200) ? bg_color.r + 55 : 255;
-        bg_color.g = (bg_color.g < 200) ? bg_color.g + 55 : 255;
-        bg_color.b = (bg_color.b < 200) ? bg_color.b + 55 : 255;
-        
-        // Brighten border on hover
-        border_color.r = (border_color.r < 200) ? border_color.r + 55 : 255;
-        border_color.g = (border_color.g < 200) ? border_color.g + 255 : 255;
-        border_color.b = (border_color.b < 200) ? border_color.b + 55 : 255;
+// Hover for draw_element() callers without a context: every drawn interactive element
+// under the pointer counts as hovered
+static void update_hover_immediate(RenderElement* el, Vector2 mouse_pos, float scale_factor) {
+    if (!el || el->is_placeholder || !el->is_visible) return;
+
+    bool hovered = el->is_interactive &&
+        mouse_pos.x >= el->render_x && mouse_pos.x < el->render_x + el->render_w &&
+        mouse_pos.y >= el->render_y && mouse_pos.y < el->render_y + el->render_h;
+    uint8_t state = el->cold->current_state;
+    update_element_state(el, hovered ? (uint8_t)(state | STATE_HOVER) : (uint8_t)(state & ~STATE_HOVER), NULL, NULL);
+    if (hovered) SetMouseCursor(MOUSE_CURSOR_POINTING_HAND);
+
+    // Children were only laid out when there was room for them
+    Rectangle content = element_content_rect(el, scale_factor);
+    if (content.width > 0 && content.height > 0) {
+        for (int i = 0; i < el->child_count; i++) {
+            update_hover_immediate(el->children[i], mouse_pos, scale_factor);
+        }
     }
+}
+
+void record_element(RenderElement* el, float scale_factor, DrawList* list, FILE* debug_file) {
+    if (!el) return;
 
-    int top_bw = (int)(el->border_widths[0] * scale_factor);
-    int right_bw = (int)(el->border_widths[1] * scale_factor);
-    int bottom_bw = (int)(el->border_widths[2] * scale_factor);
-    int left_bw = (int)(el->border_widths[3] * scale_factor);
+    // Skip rendering placeholder elements
+    if (el->is_placeholder) {
+        if (debug_file) {
+            fprintf(debug_file, "DEBUG RENDER: Skipping placeholder element %d\n", el->original_index);
+        }
+        return;
+    }
 
-    // Clamp borders if they exceed element size
-    if (el->render_h > 0 && top_bw + bottom_bw >= el->render_h) { 
-        top_bw = el->render_h > 1 ? 1 : el->render_h; 
-        bottom_bw = 0; 
+    // Skip rendering invisible elements
+    if (!el->is_visible) {
+        if (debug_file) {
+            fprintf(debug_file, "DEBUG RENDER: Skipping invisible element %d\n", el->original_index);
+        }
+        return;
     }
-    if (el->render_w > 0 && left_bw + right_bw >= el->render_w) { 
-        left_bw = el->render_w > 1 ? 1 : el->render_w; 
-        right_bw = 0; 
+
+    // --- Apply Styling (state paint is already swapped in by update_element_state()) ---
+    Color bg_color = el->bg_color;
+    Color fg_color = el->fg_color;
+    Color border_color = el->border_color;
+    if (el->opacity < 255) {
+        bg_color = apply_opacity(bg_color, el->opacity);
+        border_color = apply_opacity(border_color, el->opacity);
     }
 
+    int bw[4];
+    element_border_widths(el, scale_factor, bw);
+    int top_bw = bw[0], right_bw = bw[1], bottom_bw = bw[2], left_bw = bw[3];
+
     // Debug Logging
     if (debug_file) {
-        fprintf(debug_file, "DEBUG RENDER: Elem %d (Type=0x%02X) @(%d,%d) Size=%dx%d Borders=[%d,%d,%d,%d] Layout=0x%02X ResIdx=%d Visible=%s Hovered=%s\n",
-                el->original_index, el->header.type, el->render_x, el->render_y, el->render_w, el->render_h,
-                top_bw, right_bw, bottom_bw, left_bw, el->header.layout, el->resource_index,
-                el->is_visible ? "true" : "false", is_hovered ? "true" : "false");
+        fprintf(debug_file, "DEBUG RENDER: Elem %d (Type=0x%02X) @(%d,%d) Size=%dx%d Borders=[%d,%d,%d,%d] Layout=0x%02X ResIdx=%d Visible=%s State=0x%02X\n",
+                el->original_index, el->type, el->render_x, el->render_y, el->render_w, el->render_h,
+                top_bw, right_bw, bottom_bw, left_bw, el->layout, el->cold->resource_index,
+                el->is_visible ? "true" : "false", el->cold->current_state);
     }
 
-    // --- Draw Background ---
-    bool draw_background = (el->header.type != ELEM_TYPE_TEXT);
+    // --- Background ---
+    bool draw_background = (el->type != ELEM_TYPE_TEXT);
     if (draw_background && el->render_w > 0 && el->render_h > 0 && bg_color.a > 0) {
-        DrawRectangle(el->render_x, el->render_y, el->render_w, el->render_h, bg_color);
+        draw_list_rect(list, el->render_x, el->render_y, el->render_w, el->render_h, bg_color);
     }
 
-    // --- Draw Borders ---
+    // --- Borders ---
     if (el->render_w > 0 && el->render_h > 0 && border_color.a > 0) {
-        if (top_bw > 0) DrawRectangle(el->render_x, el->render_y, el->render_w, top_bw, border_color);
-        if (bottom_bw > 0) DrawRectangle(el->render_x, el->render_y + el->render_h - bottom_bw, el->render_w, bottom_bw, border_color);
+        if (top_bw > 0) draw_list_rect(list, el->render_x, el->render_y, el->render_w, top_bw, border_color);
+        if (bottom_bw > 0) draw_list_rect(list, el->render_x, el->render_y + el->render_h - bottom_bw, el->render_w, bottom_bw, border_color);
         int side_border_y = el->render_y + top_bw;
         int side_border_height = el->render_h - top_bw - bottom_bw; 
         if (side_border_height < 0) side_border_height = 0;
-        if (left_bw > 0) DrawRectangle(el->render_x, side_border_y, left_bw, side_border_height, border_color);
-        if (right_bw > 0) DrawRectangle(el->render_x + el->render_w - right_bw, side_border_y, right_bw, side_border_height, border_color);
+        if (left_bw > 0) draw_list_rect(list, el->render_x, side_border_y, left_bw, side_border_height, border_color);
+        if (right_bw > 0) draw_list_rect(list, el->render_x + el->render_w - right_bw, side_border_y, right_bw, side_border_height, border_color);
     }
 
     // --- Calculate Content Area ---
-    int content_x = el->render_x + left_bw;
-    int content_y = el->render_y + top_bw;
-    int content_width = el->render_w - left_bw - right_bw;
-    int content_height = el->render_h - top_bw - bottom_bw;
-    if (content_width < 0) content_width = 0;
-    if (content_height < 0) content_height = 0;
+    Rectangle content = element_content_rect(el, scale_factor);
+    int content_x = (int)content.x;
+    int content_y = (int)content.y;
+    int content_width = (int)content.width;
+    int content_height = (int)content.height;
 
-    // --- Draw Content (Text or Image) ---
+    // --- Content (Text or Image), clipped to the content area ---
     if (content_width > 0 && content_height > 0) {
-        BeginScissorMode(content_x, content_y, content_width, content_height);
-
-        // Draw Text
-        if ((el->header.type == ELEM_TYPE_TEXT || el->header.type == ELEM_TYPE_BUTTON) && el->text && el->text[0] != '\0') {
+        // Text
+        if ((el->type == ELEM_TYPE_TEXT || el->type == ELEM_TYPE_BUTTON) && el->cold->text && el->cold->text[0] != '\0') {
             float font_size = (el->font_size > 0) ? el->font_size : BASE_FONT_SIZE;
             int scaled_font_size = (int)(font_size * scale_factor);
             if (scaled_font_size < 1) scaled_font_size = 1;
             
-            int text_width_measured = MeasureText(el->text, scaled_font_size);
+            int text_width_measured = measure_element_text(el, scaled_font_size);
             int text_draw_x = content_x;
             if (el->text_alignment == 1) text_draw_x = content_x + (content_width - text_width_measured) / 2; // Center
             else if (el->text_alignment == 2) text_draw_x = content_x + content_width - text_width_measured;   // End/Right
@@ -1014,191 +1551,331 @@ void render_element(RenderElement* el, int parent_content_x, int parent_content_
             }
 
             if (debug_file) fprintf(debug_file, "  -> Drawing Text (Type %02X) '%s' (align=%d) with color (%d,%d,%d,%d) at (%d,%d) font_size=%d within content (%d,%d %dx%d)\n", 
-                                   el->header.type, el->text, el->text_alignment, fg_color.r, fg_color.g, fg_color.b, fg_color.a,
+                                   el->type, el->cold->text, el->text_alignment, fg_color.r, fg_color.g, fg_color.b, fg_color.a,
                                    text_draw_x, text_draw_y, scaled_font_size, content_x, content_y, content_width, content_height);
-            DrawText(el->text, text_draw_x, text_draw_y, scaled_font_size, fg_color);
+            draw_list_scissor_begin(list, content_x, content_y, content_width, content_height);
+            draw_list_text(list, el->cold->text, text_draw_x, text_draw_y, scaled_font_size, apply_opacity(fg_color, el->opacity));
+            draw_list_scissor_end(list);
         }
         
-        // Draw Image
-        else if (el->header.type == ELEM_TYPE_IMAGE && el->texture_loaded) {
+        // Image
+        else if (el->type == ELEM_TYPE_IMAGE && el->cold->texture_loaded) {
              if (debug_file) fprintf(debug_file, "  -> Drawing Image Texture (ResIdx %d) within content (%d,%d %dx%d)\n", 
-                                    el->resource_index, content_x, content_y, content_width, content_height);
-             Rectangle sourceRec = { 0.0f, 0.0f, (float)el->texture.width, (float)el->texture.height };
+                                    el->cold->resource_index, content_x, content_y, content_width, content_height);
+             Rectangle sourceRec = { 0.0f, 0.0f, (float)el->cold->texture.width, (float)el->cold->texture.height };
              Rectangle destRec = { (float)content_x, (float)content_y, (float)content_width, (float)content_height };
-             Vector2 origin = { 0.0f, 0.0f };
-             DrawTexturePro(el->texture, sourceRec, destRec, origin, 0.0f, WHITE);
+             draw_list_scissor_begin(list, content_x, content_y, content_width, content_height);
+             draw_list_texture(list, el->cold->texture, sourceRec, destRec, apply_opacity(WHITE, el->opacity));
+             draw_list_scissor_end(list);
         }
 
-        EndScissorMode();
+        // Children were only laid out when there was room for them
+        for (int i = 0; i < el->child_count; i++) {
+            if (el->children[i]) record_element(el->children[i], scale_factor, list, debug_file);
+        }
     }
 
-    // --- Handle Click Events ---
-    if (el->header.type == ELEM_TYPE_BUTTON && is_hovered && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-        if (debug_file) {
-            fprintf(debug_file, "BUTTON CLICKED: Element %d\n", el->original_index);
+    if (debug_file) fprintf(debug_file, "  Finished Render Elem %d\n", el->original_index);
+}
+
+void draw_element(RenderElement* el, float scale_factor, FILE* debug_file) {
+    if (!el) return;
+    update_hover_immediate(el, GetMousePosition(), scale_factor);
+    DrawList list = {0};
+    record_element(el, scale_factor, &list, debug_file);
+    replay_draw_list(&list);
+    free_draw_list(&list);
+}
+
+void render_element(RenderElement* el, int parent_content_x, int parent_content_y, int parent_content_width, int parent_content_height, float scale_factor, FILE* debug_file) {
+    layout_element(el, parent_content_x, parent_content_y, parent_content_width, parent_content_height, scale_factor, debug_file);
+    draw_element(el, scale_factor, debug_file);
+}
+
+void mark_layout_dirty(RenderContext* ctx) {
+    if (ctx) ctx->layout_dirty = true;
+}
+
+void mark_paint_dirty(RenderContext* ctx) {
+    if (!ctx) return;
+    ctx->paint_dirty = true;
+    ctx->full_damage = true;
+}
+
+static Rectangle union_rects(Rectangle a, Rectangle b) {
+    float x0 = fminf(a.x, b.x), y0 = fminf(a.y, b.y);
+    float x1 = fmaxf(a.x + a.width, b.x + b.width), y1 = fmaxf(a.y + a.height, b.y + b.height);
+    return (Rectangle){ x0, y0, x1 - x0, y1 - y0 };
+}
+
+static bool rects_overlap(Rectangle a, Rectangle b) {
+    return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+void add_damage_rect(RenderContext* ctx, Rectangle rect) {
+    if (!ctx) return;
+    ctx->paint_dirty = true;
+    if (ctx->full_damage) return;
+
+    // Clip to the window
+    Rectangle window = { 0.0f, 0.0f, (float)ctx->window_width, (float)ctx->window_height };
+    if (!rects_overlap(rect, window)) return;
+    float x1 = fminf(rect.x + rect.width, window.width), y1 = fminf(rect.y + rect.height, window.height);
+    rect.x = fmaxf(rect.x, 0.0f);
+    rect.y = fmaxf(rect.y, 0.0f);
+    rect.width = x1 - rect.x;
+    rect.height = y1 - rect.y;
+
+    // Overlapping damage is merged so no area is repainted twice
+    for (int i = 0; i < ctx->damage_count; i++) {
+        if (rects_overlap(ctx->damage_rects[i], rect)) {
+            rect = union_rects(ctx->damage_rects[i], rect);
+            ctx->damage_rects[i] = ctx->damage_rects[--ctx->damage_count];
+            i = -1; // The grown rect may now overlap ones already checked
         }
-        // You can add onClick handler logic here
     }
+    if (ctx->damage_count == MAX_DAMAGE_RECTS) {
+        for (int i = 0; i < ctx->damage_count; i++) rect = union_rects(ctx->damage_rects[i], rect);
+        ctx->damage_count = 0;
+    }
+    ctx->damage_rects[ctx->damage_count++] = rect;
+}
 
-    // [Rest of the function remains the same - layout and render children section]
-    if (el->child_count > 0 && content_width > 0 && content_height > 0) {
-        uint8_t direction = el->header.layout & LAYOUT_DIRECTION_MASK;
-        uint8_t alignment = (el->header.layout & LAYOUT_ALIGNMENT_MASK) >> 2;
-        int current_flow_x = content_x;
-        int current_flow_y = content_y;
-        int total_child_width_scaled = 0;
-        int total_child_height_scaled = 0;
-        int flow_child_count = 0;
-        int child_sizes[MAX_ELEMENTS][2];
+void damage_element(RenderContext* ctx, RenderElement* el) {
+    if (!ctx || !el || el->render_w <= 0 || el->render_h <= 0) return;
+    add_damage_rect(ctx, (Rectangle){ (float)el->render_x, (float)el->render_y, (float)el->render_w, (float)el->render_h });
+}
 
-        if (debug_file) fprintf(debug_file, "  Layout Children of Elem %d: Count=%d Dir=%d Align=%d Content=(%d,%d %dx%d)\n", 
-                               el->original_index, el->child_count, direction, alignment, content_x, content_y, content_width, content_height);
+void invalidate_element_layout(RenderContext* ctx, RenderElement* el) {
+    if (!ctx || !el) return;
+    el->render_w = 0;
+    el->render_h = 0;
+    calculate_element_minimum_size(el, ctx->scale_factor);
+    ctx->layout_dirty = true;
+}
 
-        // Pass 1: Calculate sizes and total dimensions of flow children
-        for (int i = 0; i < el->child_count; i++) {
-            RenderElement* child = el->children[i];
-            if (!child) continue;
-            
-            if (child->is_placeholder || !child->is_visible) {
-                child_sizes[i][0] = 0; 
-                child_sizes[i][1] = 0;
-                continue;
-            }
-            
-            bool child_is_absolute = (child->header.layout & LAYOUT_ABSOLUTE_BIT);
-            bool child_has_pos = (child->header.pos_x != 0 || child->header.pos_y != 0);
+bool layout_tree(RenderContext* ctx, FILE* debug_file) {
+    if (!ctx || !ctx->layout_dirty) return false;
+    for (int i = 0; i < ctx->root_count; i++) {
+        if (ctx->roots[i]) {
+            layout_element(ctx->roots[i], 0, 0, ctx->window_width, ctx->window_height, ctx->scale_factor, debug_file);
+        }
+    }
+    ctx->layout_dirty = false;
+    ctx->paint_dirty = true;
+    ctx->full_damage = true; // Anything may have moved
+    ctx->hover_current = false;
+    build_hit_grid(ctx);
+    return true;
+}
 
-            if (child_is_absolute || child_has_pos) {
-                child_sizes[i][0] = 0; 
-                child_sizes[i][1] = 0;
-                continue;
+// Appends the drawn interactive elements under 'el' in paint order
+static bool collect_hit_targets(RenderElement* el, float scale_factor, RenderElement*** targets, int* count, int* capacity) {
+    if (!el || el->is_placeholder || !el->is_visible) return true;
+
+    if (el->is_interactive && el->render_w > 0 && el->render_h > 0) {
+        if (*count == *capacity) {
+            int grown_capacity = *capacity ? *capacity * 2 : 32;
+            RenderElement** grown = realloc(*targets, grown_capacity * sizeof(RenderElement*));
+            if (!grown) {
+                perror("realloc hit targets");
+                return false;
             }
+            *targets = grown;
+            *capacity = grown_capacity;
+        }
+        (*targets)[(*count)++] = el;
+    }
 
-            // Use pre-calculated size if available, otherwise calculate
-            int child_w, child_h;
-            if (child->render_w > 0 && child->render_h > 0) {
-                child_w = child->render_w;
-                child_h = child->render_h;
-            } else {
-                child_w = (int)(child->header.width * scale_factor);
-                child_h = (int)(child->header.height * scale_factor);
-                
-                if (child->header.type == ELEM_TYPE_TEXT && child->text) {
-                    float font_size = (child->font_size > 0) ? child->font_size : BASE_FONT_SIZE;
-                    int fs = (int)(font_size * scale_factor); if(fs<1)fs=1;
-                    int tw = (child->text[0]!='\0') ? MeasureText(child->text, fs):0;
-                    if (child->header.width == 0) child_w = tw + (int)(8 * scale_factor);
-                    if (child->header.height == 0) child_h = fs + (int)(8 * scale_factor);
-                }
-                else if (child->header.type == ELEM_TYPE_BUTTON && child->text) {
-                    float font_size = (child->font_size > 0) ? child->font_size : BASE_FONT_SIZE;
-                    int fs = (int)(font_size * scale_factor); if(fs<1)fs=1;
-                    int tw = (child->text[0]!='\0') ? MeasureText(child->text, fs):0;
-                    if (child->header.width == 0) child_w = tw + (int)(16 * scale_factor);
-                    if (child->header.height == 0) child_h = fs + (int)(16 * scale_factor);
-                }
-                else if (child->header.type == ELEM_TYPE_IMAGE && child->texture_loaded) {
-                    if (child->header.width == 0) child_w = (int)(child->texture.width * scale_factor);
-                    if (child->header.height == 0) child_h = (int)(child->texture.height * scale_factor);
-                }
-            }
+    // Children were only laid out when there was room for them
+    Rectangle content = element_content_rect(el, scale_factor);
+    if (content.width > 0 && content.height > 0) {
+        for (int i = 0; i < el->child_count; i++) {
+            if (!collect_hit_targets(el->children[i], scale_factor, targets, count, capacity)) return false;
+        }
+    }
+    return true;
+}
+
+// Cell range [c0, c1] x [r0, r1] a rect covers, clamped to the grid; false if it misses it
+static bool hit_grid_cells(const HitGrid* grid, const RenderElement* el, int* c0, int* r0, int* c1, int* r1) {
+    *c0 = el->render_x / grid->cell_size;
+    *r0 = el->render_y / grid->cell_size;
+    *c1 = (el->render_x + el->render_w - 1) / grid->cell_size;
+    *r1 = (el->render_y + el->render_h - 1) / grid->cell_size;
+    if (el->render_x < 0) *c0 = 0;
+    if (el->render_y < 0) *r0 = 0;
+    if (*c1 >= grid->cols) *c1 = grid->cols - 1;
+    if (*r1 >= grid->rows) *r1 = grid->rows - 1;
+    return el->render_x + el->render_w > 0 && el->render_y + el->render_h > 0 && *c0 <= *c1 && *r0 <= *r1;
+}
 
-            if (child_w < 0) child_w = 0;
-            if (child_h < 0) child_h = 0;
-            if (child->header.width > 0 && child_w == 0) child_w = 1;
-            if (child->header.height > 0 && child_h == 0) child_h = 1;
+void free_hit_grid(HitGrid* grid) {
+    if (!grid) return;
+    free(grid->cell_start);
+    free(grid->items);
+    memset(grid, 0, sizeof(HitGrid));
+}
 
-            child_sizes[i][0] = child_w;
-            child_sizes[i][1] = child_h;
+bool build_hit_grid(RenderContext* ctx) {
+    if (!ctx) return false;
+    HitGrid* grid = &ctx->hit_grid;
+    free_hit_grid(grid);
 
-            if (direction == 0x00 || direction == 0x02) {
-                total_child_width_scaled += child_w;
-            } else {
-                total_child_height_scaled += child_h;
-            }
-            flow_child_count++;
+    RenderElement** targets = NULL;
+    int target_count = 0, target_capacity = 0;
+    for (int i = 0; i < ctx->root_count; i++) {
+        if (!collect_hit_targets(ctx->roots[i], ctx->scale_factor, &targets, &target_count, &target_capacity)) {
+            free(targets);
+            return false;
         }
+    }
 
-        // Pass 2: Calculate starting position based on alignment
-        if (direction == 0x00 || direction == 0x02) {
-            if (alignment == 0x01) { 
-                current_flow_x = content_x + (content_width - total_child_width_scaled) / 2; 
-            } else if (alignment == 0x02) { 
-                current_flow_x = content_x + content_width - total_child_width_scaled; 
-            }
-            if (current_flow_x < content_x) current_flow_x = content_x;
-        } else {
-            if (alignment == 0x01) { 
-                current_flow_y = content_y + (content_height - total_child_height_scaled) / 2; 
-            } else if (alignment == 0x02) { 
-                current_flow_y = content_y + content_height - total_child_height_scaled; 
-            }
-            if (current_flow_y < content_y) current_flow_y = content_y;
+    grid->cell_size = HIT_GRID_CELL_SIZE;
+    grid->cols = (ctx->window_width + HIT_GRID_CELL_SIZE - 1) / HIT_GRID_CELL_SIZE;
+    grid->rows = (ctx->window_height + HIT_GRID_CELL_SIZE - 1) / HIT_GRID_CELL_SIZE;
+    if (grid->cols < 1) grid->cols = 1;
+    if (grid->rows < 1) grid->rows = 1;
+    int cell_count = grid->cols * grid->rows;
+    grid->cell_start = calloc(cell_count + 1, sizeof(int));
+    if (!grid->cell_start) {
+        perror("calloc hit grid");
+        free(targets);
+        return false;
+    }
+
+    // Count per cell, turn counts into offsets, then fill; targets stay in paint order
+    int c0, r0, c1, r1;
+    for (int t = 0; t < target_count; t++) {
+        if (!hit_grid_cells(grid, targets[t], &c0, &r0, &c1, &r1)) continue;
+        for (int r = r0; r <= r1; r++) {
+            for (int c = c0; c <= c1; c++) grid->cell_start[r * grid->cols + c + 1]++;
+        }
+    }
+    for (int i = 0; i < cell_count; i++) grid->cell_start[i + 1] += grid->cell_start[i];
+    grid->item_count = grid->cell_start[cell_count];
+    grid->items = malloc((grid->item_count ? grid->item_count : 1) * sizeof(RenderElement*));
+    int* fill = malloc(cell_count * sizeof(int));
+    if (!grid->items || !fill) {
+        perror("malloc hit grid");
+        free(fill);
+        free(targets);
+        free_hit_grid(grid);
+        return false;
+    }
+    memcpy(fill, grid->cell_start, cell_count * sizeof(int));
+    for (int t = 0; t < target_count; t++) {
+        if (!hit_grid_cells(grid, targets[t], &c0, &r0, &c1, &r1)) continue;
+        for (int r = r0; r <= r1; r++) {
+            for (int c = c0; c <= c1; c++) grid->items[fill[r * grid->cols + c]++] = targets[t];
         }
+    }
+    free(fill);
+    free(targets);
+    return true;
+}
 
-        // Calculate spacing for SpaceBetween
-        float space_between = 0;
-        if (alignment == 0x03 && flow_child_count > 1) {
-            if (direction == 0x00 || direction == 0x02) {
-                space_between = (float)(content_width - total_child_width_scaled) / (flow_child_count - 1);
-            } else {
-                space_between = (float)(content_height - total_child_height_scaled) / (flow_child_count - 1);
-            }
-            if (space_between < 0) space_between = 0;
+RenderElement* hit_test(const RenderContext* ctx, Vector2 point) {
+    if (!ctx || !ctx->hit_grid.cell_start || point.x < 0 || point.y < 0) return NULL;
+    const HitGrid* grid = &ctx->hit_grid;
+    int c = (int)point.x / grid->cell_size;
+    int r = (int)point.y / grid->cell_size;
+    if (c >= grid->cols || r >= grid->rows) return NULL;
+
+    // Later entries are painted later, so the first match from the back is topmost
+    int cell = r * grid->cols + c;
+    for (int i = grid->cell_start[cell + 1] - 1; i >= grid->cell_start[cell]; i--) {
+        RenderElement* el = grid->items[i];
+        if (point.x >= el->render_x && point.x < el->render_x + el->render_w &&
+            point.y >= el->render_y && point.y < el->render_y + el->render_h) {
+            return el;
+        }
+    }
+    return NULL;
+}
+
+void update_hover_state(RenderContext* ctx) {
+    if (!ctx) return;
+    RenderElement* hovered = hit_test(ctx, GetMousePosition());
+    ctx->hover_current = true;
+
+    if (hovered != ctx->hovered) {
+        if (ctx->hovered) {
+            update_element_state(ctx->hovered, (uint8_t)(ctx->hovered->cold->current_state & ~STATE_HOVER), ctx, NULL);
+        }
+        if (hovered) {
+            update_element_state(hovered, (uint8_t)(hovered->cold->current_state | STATE_HOVER), ctx, NULL);
         }
+        ctx->hovered = hovered;
+        SetMouseCursor(hovered ? MOUSE_CURSOR_POINTING_HAND : MOUSE_CURSOR_DEFAULT);
+    }
+}
 
-        // Pass 3: Position and render children
-        int flow_children_processed = 0;
-        for (int i = 0; i < el->child_count; i++) {
-            RenderElement* child = el->children[i];
-            if (!child) continue;
-            
-            if (child->is_placeholder || !child->is_visible) continue;
-
-            bool child_is_absolute = (child->header.layout & LAYOUT_ABSOLUTE_BIT);
-            bool child_has_pos = (child->header.pos_x != 0 || child->header.pos_y != 0);
-
-            if (child_is_absolute || child_has_pos) {
-                render_element(child, content_x, content_y, content_width, content_height, scale_factor, debug_file);
-            } else {
-                int child_w = child_sizes[i][0];
-                int child_h = child_sizes[i][1];
-                int child_final_x, child_final_y;
-
-                if (direction == 0x00 || direction == 0x02) {
-                    child_final_x = current_flow_x;
-                    if (alignment == 0x01) child_final_y = content_y + (content_height - child_h) / 2;
-                    else if (alignment == 0x02) child_final_y = content_y + content_height - child_h;
-                    else child_final_y = content_y;
-                } else {
-                    child_final_y = current_flow_y;
-                    if (alignment == 0x01) child_final_x = content_x + (content_width - child_w) / 2;
-                    else if (alignment == 0x02) child_final_x = content_x + content_width - child_w;
-                    else child_final_x = content_x;
-                }
+bool build_draw_list(RenderContext* ctx, FILE* debug_file) {
+    if (!ctx || !ctx->paint_dirty) return false;
+    clear_draw_list(&ctx->draw_list);
+    for (int i = 0; i < ctx->root_count; i++) {
+        if (ctx->roots[i]) record_element(ctx->roots[i], ctx->scale_factor, &ctx->draw_list, debug_file);
+    }
+    ctx->paint_dirty = false;
+    return true;
+}
 
-                child->render_x = child_final_x;
-                child->render_y = child_final_y;
+bool prepare_frame(RenderContext* ctx, FILE* debug_file) {
+    if (!ctx) return false;
+    layout_tree(ctx, debug_file);
+    // dispatch_pointer_events() usually queried already; the next frame needs a fresh one
+    if (!ctx->hover_current) update_hover_state(ctx);
+    ctx->hover_current = false;
+    return build_draw_list(ctx, debug_file);
+}
 
-                render_element(child, content_x, content_y, content_width, content_height, scale_factor, debug_file);
+void present_frame(RenderContext* ctx, Color clear_color) {
+    if (!ctx) return;
+    // A new backbuffer (first frame or window resized) has no valid pixels yet
+    if (ctx->backbuffer.id == 0 || ctx->backbuffer.texture.width != ctx->window_width ||
+        ctx->backbuffer.texture.height != ctx->window_height) {
+        unload_backbuffer(ctx);
+        ctx->backbuffer = LoadRenderTexture(ctx->window_width, ctx->window_height);
+        ctx->full_damage = true;
+    }
 
-                if (direction == 0x00 || direction == 0x02) {
-                    current_flow_x += child_w;
-                    if (alignment == 0x03 && flow_children_processed < flow_child_count - 1) {
-                        current_flow_x += (int)roundf(space_between);
-                    }
-                } else {
-                    current_flow_y += child_h;
-                    if (alignment == 0x03 && flow_children_processed < flow_child_count - 1) {
-                        current_flow_y += (int)roundf(space_between);
-                    }
-                }
-                flow_children_processed++;
-            }
+    BeginTextureMode(ctx->backbuffer);
+    if (ctx->full_damage) {
+        ClearBackground(clear_color);
+        replay_draw_list(&ctx->draw_list);
+    } else {
+        for (int i = 0; i < ctx->damage_count; i++) {
+            Rectangle r = ctx->damage_rects[i];
+            BeginScissorMode((int)r.x, (int)r.y, (int)r.width, (int)r.height);
+            ClearBackground(clear_color); // Clears only inside the scissor
+            EndScissorMode();
+            replay_draw_list_clipped(&ctx->draw_list, r);
         }
     }
+    EndTextureMode();
+    ctx->full_damage = false;
+    ctx->damage_count = 0;
 
-    if (debug_file) fprintf(debug_file, "  Finished Render Elem %d\n", el->original_index);
+    BeginDrawing();
+    // Render textures are stored bottom-up, hence the negative source height
+    Rectangle source = { 0.0f, 0.0f, (float)ctx->backbuffer.texture.width, (float)-ctx->backbuffer.texture.height };
+    DrawTextureRec(ctx->backbuffer.texture, source, (Vector2){ 0.0f, 0.0f }, WHITE);
+    EndDrawing();
+}
+
+void unload_backbuffer(RenderContext* ctx) {
+    if (!ctx || ctx->backbuffer.id == 0) return;
+    UnloadRenderTexture(ctx->backbuffer);
+    memset(&ctx->backbuffer, 0, sizeof(ctx->backbuffer));
+}
+
+void draw_tree(RenderContext* ctx, FILE* debug_file) {
+    if (!ctx) return;
+    if (!ctx->hover_current) update_hover_state(ctx);
+    ctx->hover_current = false;
+    build_draw_list(ctx, debug_file);
+    replay_draw_list(&ctx->draw_list);
 }
 
 #ifdef BUILD_STANDALONE_RENDERER
@@ -1275,7 +1952,7 @@ int main(int argc, char* argv[]) {
         apply_contextual_defaults(el, ctx, debug_file);
         
         fprintf(debug_file, "INFO: Initialized Elem %d. Text='%s' Visible=%s\n", 
-                i, el->text ? el->text : "NULL", el->is_visible ? "true" : "false");
+                i, el->cold->text ? el->cold->text : "NULL", el->is_visible ? "true" : "false");
     }
 
     // Step 5: Apply Property Inheritance (existing code)
@@ -1308,6 +1985,7 @@ int main(int argc, char* argv[]) {
     
     // --- Find Roots ---
     find_root_elements(ctx, debug_file);
+    resolve_all_state_properties(ctx, debug_file);
     // --- Initialize Raylib ---
     InitWindow(ctx->window_width, ctx->window_height, 
         ctx->window_title ? ctx->window_title : "KRB Renderer");
@@ -1319,40 +1997,75 @@ int main(int argc, char* argv[]) {
     for (int i = 0; i < ctx->element_count; i++) {
     RenderElement* el = &ctx->elements[i];
     fprintf(debug_file, "CALCULATING SIZE FOR ELEMENT %d (type=0x%02X) text='%s'\n", 
-        i, el->header.type, el->text ? el->text : "NULL");
+        i, el->type, el->cold->text ? el->cold->text : "NULL");
     calculate_element_minimum_size(el, ctx->scale_factor);
     fprintf(debug_file, "  -> Final size: %dx%d\n", el->render_w, el->render_h);
     }
 
     // --- Load Textures ---
     load_all_textures(ctx, krb_dir, debug_file);
+
+    // --- Start Animations ---
+    AnimationEngine animations;
+    if (!init_animation_engine(&animations, ctx, GetTime(), debug_file)) {
+        fprintf(stderr, "ERROR: Failed to set up animations\n");
+        CloseWindow();
+        free_render_context(ctx);
+        krb_free_document(&doc); free(krb_file_path_copy);
+        if (debug_file != stderr) fclose(debug_file);
+        return 1;
+    }
+    
+    // --- Bind Events ---
+    // The standalone renderer registers no callbacks; unbound names are logged and clicks
+    // still go through the dispatcher
+    EventDispatcher events;
+    init_event_dispatcher(&events, ctx);
+    resolve_event_handlers(&events, debug_file);
     
     // --- Main Loop ---
     while (!WindowShouldClose()) {
         handle_window_resize(ctx);
+        dispatch_pointer_events(&events, debug_file);
+
+        // Advance all animations in one batch; paint-only tracks skip re-measuring and
+        // only size-affecting ones cost a re-layout
+        double now = GetTime();
+        RenderElement* pressed = IsMouseButtonPressed(MOUSE_BUTTON_LEFT) ? events.pressed : NULL;
+        update_animation_triggers(&animations, ctx->hovered, pressed, now);
+        // Paint-only runs repaint just their element; size changes re-layout, which repaints everything
+        for (int i = 0; i < animations.run_count; i++) damage_element(ctx, animations.runs[i].element);
+        uint8_t anim_dirty = update_animations(&animations, now);
+        if (anim_dirty & ANIM_DIRTY_LAYOUT) mark_layout_dirty(ctx);
+        // Runs on elements without a laid-out rect add no damage, but the frame must still
+        // be presented so EndDrawing() paces the loop
+        else if (anim_dirty & ANIM_DIRTY_PAINT) ctx->paint_dirty = true;
+
+        // Rects, the hit grid and draw commands are reused until something marks them dirty
+        bool frame_changed = prepare_frame(ctx, debug_file);
         
-        // Reset cursor tracking at start of each frame
-        reset_cursor_for_frame();
+        // Idle screens block in the next event poll until input arrives; running
+        // animations need a steady frame rate instead
+        if (animations_running(&animations)) DisableEventWaiting();
+        else EnableEventWaiting();
         
-        BeginDrawing();
-        Color clear_color = (app_element) ? app_element->bg_color : BLACK; 
-        ClearBackground(clear_color);
-        
-        // Render all root elements
-        for (int i = 0; i < ctx->root_count; i++) {
-            if (ctx->roots[i]) {
-                render_element(ctx->roots[i], 0, 0, ctx->window_width, ctx->window_height, ctx->scale_factor, debug_file); 
+        if (frame_changed) {
+            Color clear_color = (app_element) ? app_element->bg_color : BLACK; 
+            present_frame(ctx, clear_color);
+        } else {
+            // The last presented frame is still current; only wait for input. With waiting
+            // disabled that returns at once, so sleep out the rest of the frame instead of spinning
+            PollInputEvents();
+            if (animations_running(&animations)) {
+                double remaining = 1.0/60.0 - (GetTime() - now);
+                if (remaining > 0.0) WaitTime(remaining);
             }
         }
-        
-        // If no interactive element was hovered, ensure default cursor
-        if (!g_cursor_set_this_frame) {
-            SetMouseCursor(MOUSE_CURSOR_DEFAULT);
-        }
-        
-        EndDrawing();
     }
     // --- Cleanup ---
+    free_animation_engine(&animations);
+    free_event_dispatcher(&events);
+    unload_backbuffer(ctx);
     CloseWindow();
     free_render_context(ctx);
     krb_free_document(&doc);
@@ -1362,4 +2075,4 @@ int main(int argc, char* argv[]) {
     return 0;
 }
 
-#endif // BUILD_STANDALONE_RENDERER
\ No newline at end of file
+#endif // BUILD_STANDALONE_RENDERER
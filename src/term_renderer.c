@@ -7,7 +7,6 @@
 #include <termbox.h>
 #include "krb.h" // Assume this defines Krb* structs and PROP_ID_*
 
-#define MAX_ELEMENTS 256 // Local definition if not in krb.h
 
 // --- KRB Property ID Defines (Ensure these match your krb.h/spec) ---
 #ifndef PROP_ID_BG_COLOR
@@ -38,7 +37,7 @@ typedef struct RenderElement {
     uint8_t border_widths[4]; // T, R, B, L
     uint8_t text_alignment; // 0=left, 1=center, 2=right
     struct RenderElement* parent;
-    struct RenderElement* children[MAX_ELEMENTS];
+    struct RenderElement** children; // Span of the shared child slot array
     int child_count;
     // --- Add App-specific properties read during processing ---
     uint16_t app_design_width;
@@ -49,12 +48,12 @@ typedef struct RenderElement {
 } RenderElement;
 
 // --- Helper to get uint16 property value (assumes Little Endian KRB storage) ---
-uint16_t get_property_u16(KrbProperty* props, uint8_t count, uint8_t prop_id, uint16_t default_val) {
-    for (uint8_t i = 0; i < count; ++i) {
-        if (props[i].property_id == prop_id && props[i].value_type == 0x02 && props[i].size == 2 && props[i].value) {
-            uint8_t* bytes = (uint8_t*)props[i].value;
-            return (uint16_t)(bytes[0] | (bytes[1] << 8)); // KRB uses LE
-        }
+// Lookups go through the parse-time property index: a bit test and one array read.
+uint16_t get_property_u16(KrbProperty* props, uint8_t count, const KrbPropertyIndex* index, uint8_t prop_id, uint16_t default_val) {
+    const KrbProperty* prop = krb_find_property(props, count, index, prop_id);
+    if (prop && prop->value_type == 0x02 && prop->size == 2 && prop->value) {
+        uint8_t* bytes = (uint8_t*)prop->value;
+        return (uint16_t)(bytes[0] | (bytes[1] << 8)); // KRB uses LE
     }
     return default_val;
 }
@@ -78,11 +77,10 @@ uint32_t get_property_u32_color(KrbProperty* prop) {
 
 
 // --- Helper to get uint8/bool property value ---
-bool get_property_bool(KrbProperty* props, uint8_t count, uint8_t prop_id, bool default_val) {
-     for (uint8_t i = 0; i < count; ++i) {
-        if (props[i].property_id == prop_id && props[i].value_type == 0x01 && props[i].size == 1 && props[i].value) {
-            return (*(uint8_t*)props[i].value) != 0;
-        }
+bool get_property_bool(KrbProperty* props, uint8_t count, const KrbPropertyIndex* index, uint8_t prop_id, bool default_val) {
+    const KrbProperty* prop = krb_find_property(props, count, index, prop_id);
+    if (prop && prop->value_type == 0x01 && prop->size == 1 && prop->value) {
+        return (*(uint8_t*)prop->value) != 0;
     }
     return default_val;
 }
@@ -149,6 +147,25 @@ char* strip_quotes(const char* input) {
 
 
 // --- Rendering Function (Termbox - WITH SCALING) ---
+// Cell size of a child in its parent's flow. Both layout passes recompute it instead of
+// keeping a per-level stack array sized by the (u16) child count.
+static void scaled_child_size(const RenderElement* child, double scale_x, double scale_y, int* out_w, int* out_h) {
+    int w = (int)round(child->header.width * scale_x);
+    int h = (int)round(child->header.height * scale_y);
+    if (child->header.type == 0x02 && child->text) {
+        if (child->header.width == 0) w = strlen(child->text) + 2;
+        if (child->header.height == 0) h = 1;
+    }
+    if (child->header.type == 0x01 && child->header.width == 0) w = 3;
+    if (child->header.type == 0x01 && child->header.height == 0) h = 3;
+    if (child->header.width > 0 && w <= 0) w = 1;
+    if (child->header.height > 0 && h <= 0) h = 1;
+    if (w < 0) w = 0;
+    if (h < 0) h = 0;
+    *out_w = w;
+    *out_h = h;
+}
+
 void render_element(RenderElement* el,
                     int parent_content_x, int parent_content_y,
                     int parent_content_width, int parent_content_height,
@@ -173,10 +190,10 @@ void render_element(RenderElement* el,
         if (el->child_count > 0 && parent_content_width > 0 && parent_content_height > 0) {
             // ... (Calculate scaled sizes, layout origin, alignment, spacing) ...
             uint8_t direction = el->header.layout & LAYOUT_DIRECTION_MASK; uint8_t alignment = (el->header.layout & LAYOUT_ALIGNMENT_MASK) >> 2;
-            int total_child_width = 0, total_child_height = 0, flow_child_count = 0; int child_scaled_sizes[MAX_ELEMENTS][2];
+            int total_child_width = 0, total_child_height = 0, flow_child_count = 0;
             for (int i = 0; i < el->child_count; i++) { /* ... calc scaled_w/h ... */
-                 RenderElement* child = el->children[i]; if (!child) continue; int scaled_w = (int)round(child->header.width*scale_x); int scaled_h=(int)round(child->header.height*scale_y);
-                 if(child->header.type==0x02&&child->text){if(child->header.width==0)scaled_w=strlen(child->text)+2; if(child->header.height==0)scaled_h=1;} if(child->header.type==0x01&&child->header.width==0)scaled_w=3;if(child->header.type==0x01&&child->header.height==0)scaled_h=3;if(child->header.width>0&&scaled_w<=0)scaled_w=1;if(child->header.height>0&&scaled_h<=0)scaled_h=1;if(scaled_w<0)scaled_w=0;if(scaled_h<0)scaled_h=0; child_scaled_sizes[i][0]=scaled_w; child_scaled_sizes[i][1]=scaled_h; bool child_has_pos=(child->header.pos_x!=0||child->header.pos_y!=0); if(!child_has_pos){if(direction==0||direction==2)total_child_width+=scaled_w; else total_child_height+=scaled_h; flow_child_count++;}
+                 RenderElement* child = el->children[i]; if (!child) continue; int scaled_w, scaled_h; scaled_child_size(child, scale_x, scale_y, &scaled_w, &scaled_h);
+                 bool child_has_pos=(child->header.pos_x!=0||child->header.pos_y!=0); if(!child_has_pos){if(direction==0||direction==2)total_child_width+=scaled_w; else total_child_height+=scaled_h; flow_child_count++;}
             }
             int current_x = parent_content_x + offset_x, current_y = parent_content_y + offset_y; int available_flow_width = parent_content_width - offset_x*2; int available_flow_height = parent_content_height - offset_y*2;
             if(direction==0||direction==2){ if(alignment==1)current_x=parent_content_x+offset_x+(available_flow_width-total_child_width)/2; else if(alignment==2)current_x=parent_content_x+parent_content_width-offset_x-total_child_width; if(current_x<parent_content_x+offset_x)current_x=parent_content_x+offset_x;} else { if(alignment==1)current_y=parent_content_y+offset_y+(available_flow_height-total_child_height)/2; else if(alignment==2)current_y=parent_content_y+parent_content_height-offset_y-total_child_height; if(current_y<parent_content_y+offset_y)current_y=parent_content_y+offset_y;}
@@ -185,7 +202,7 @@ void render_element(RenderElement* el,
             int flow_children_processed = 0;
             for (int i = 0; i < el->child_count; i++) {
                 RenderElement* child = el->children[i]; if (!child) continue;
-                int child_w = child_scaled_sizes[i][0], child_h = child_scaled_sizes[i][1];
+                int child_w, child_h; scaled_child_size(child, scale_x, scale_y, &child_w, &child_h);
                 int child_render_origin_x, child_render_origin_y;
                 bool child_has_pos = (child->header.pos_x != 0 || child->header.pos_y != 0);
                  if(child_has_pos){ child_render_origin_x=parent_content_x+offset_x; child_render_origin_y=parent_content_y+offset_y;} else {child_render_origin_x=current_x; child_render_origin_y=current_y; if(direction==0||direction==2){if(alignment==1)child_render_origin_y=parent_content_y+offset_y+(available_flow_height-child_h)/2;else if(alignment==2)child_render_origin_y=parent_content_y+parent_content_height-offset_y-child_h; else child_render_origin_y=parent_content_y+offset_y;} else {if(alignment==1)child_render_origin_x=parent_content_x+offset_x+(available_flow_width-child_w)/2; else if(alignment==2)child_render_origin_x=parent_content_x+parent_content_width-offset_x-child_w; else child_render_origin_x=parent_content_x+offset_x;} if(child_render_origin_x<parent_content_x+offset_x)child_render_origin_x=parent_content_x+offset_x; if(child_render_origin_y<parent_content_y+offset_y)child_render_origin_y=parent_content_y+offset_y; if(direction==0||direction==2){current_x+=child_w; if(alignment==3&&flow_children_processed<flow_child_count-1)current_x+=space_between;}else{current_y+=child_h; if(alignment==3&&flow_children_processed<flow_child_count-1)current_y+=space_between;} flow_children_processed++;}
@@ -293,16 +310,16 @@ void render_element(RenderElement* el,
     if (el->child_count > 0 && content_width > 0 && content_height > 0) {
         // ... (Calculate scaled sizes, layout origin, alignment, spacing - unchanged) ...
         uint8_t direction=el->header.layout&LAYOUT_DIRECTION_MASK; uint8_t alignment=(el->header.layout&LAYOUT_ALIGNMENT_MASK)>>2;
-        int total_child_width=0,total_child_height=0,flow_child_count=0; int child_scaled_sizes[MAX_ELEMENTS][2];
+        int total_child_width=0,total_child_height=0,flow_child_count=0;
         for(int i=0;i<el->child_count;i++){/* ... calc scaled_cw/ch ... */
-            RenderElement* child=el->children[i]; if(!child)continue; int scaled_cw=(int)round(child->header.width*scale_x); int scaled_ch=(int)round(child->header.height*scale_y); if(child->header.type==0x02&&child->text){if(child->header.width==0)scaled_cw=strlen(child->text)+2;if(child->header.height==0)scaled_ch=1;}if(child->header.type==0x01&&child->header.width==0)scaled_cw=3;if(child->header.type==0x01&&child->header.height==0)scaled_ch=3;if(child->header.width>0&&scaled_cw<=0)scaled_cw=1;if(child->header.height>0&&scaled_ch<=0)scaled_ch=1;if(scaled_cw<0)scaled_cw=0;if(scaled_ch<0)scaled_ch=0; child_scaled_sizes[i][0]=scaled_cw;child_scaled_sizes[i][1]=scaled_ch; bool child_has_pos=(child->header.pos_x!=0||child->header.pos_y!=0); if(!child_has_pos){if(direction==0||direction==2)total_child_width+=scaled_cw;else total_child_height+=scaled_ch; flow_child_count++;}}
+            RenderElement* child=el->children[i]; if(!child)continue; int scaled_cw,scaled_ch; scaled_child_size(child,scale_x,scale_y,&scaled_cw,&scaled_ch); bool child_has_pos=(child->header.pos_x!=0||child->header.pos_y!=0); if(!child_has_pos){if(direction==0||direction==2)total_child_width+=scaled_cw;else total_child_height+=scaled_ch; flow_child_count++;}}
         int current_x=content_x;int current_y=content_y; if(direction==0||direction==2){if(alignment==1)current_x=content_x+(content_width-total_child_width)/2;else if(alignment==2)current_x=content_x+content_width-total_child_width; if(current_x<content_x)current_x=content_x;}else{if(alignment==1)current_y=content_y+(content_height-total_child_height)/2;else if(alignment==2)current_y=content_y+content_height-total_child_height; if(current_y<content_y)current_y=content_y;}
         int space_between=0; if(alignment==3&&flow_child_count>1){if(direction==0||direction==2)space_between=(content_width-total_child_width)/(flow_child_count-1);else space_between=(content_height-total_child_height)/(flow_child_count-1);if(space_between<0)space_between=0;}
 
         int flow_children_processed = 0;
         for (int i = 0; i < el->child_count; i++) {
             RenderElement* child = el->children[i]; if (!child) continue;
-            int child_w = child_scaled_sizes[i][0], child_h = child_scaled_sizes[i][1];
+            int child_w, child_h; scaled_child_size(child, scale_x, scale_y, &child_w, &child_h);
             int child_render_origin_x, child_render_origin_y;
             bool child_has_pos = (child->header.pos_x != 0 || child->header.pos_y != 0);
             if(child_has_pos){/* ... absolute origin ... */ child_render_origin_x=content_x;child_render_origin_y=content_y;} else {/* ... flow origin + cross-axis + clamp ... */ child_render_origin_x=current_x;child_render_origin_y=current_y; if(direction==0||direction==2){if(alignment==1)child_render_origin_y=content_y+(content_height-child_h)/2;else if(alignment==2)child_render_origin_y=content_y+content_height-child_h; else child_render_origin_y=content_y;} else {if(alignment==1)child_render_origin_x=content_x+(content_width-child_w)/2; else if(alignment==2)child_render_origin_x=content_x+content_width-child_w; else child_render_origin_x=content_x;} if(child_render_origin_x<content_x)child_render_origin_x=content_x;if(child_render_origin_y<content_y)child_render_origin_y=content_y; if(direction==0||direction==2){current_x+=child_w;if(alignment==3&&flow_children_processed<flow_child_count-1)current_x+=space_between;}else{current_y+=child_h;if(alignment==3&&flow_children_processed<flow_child_count-1)current_y+=space_between;} flow_children_processed++;}
@@ -320,6 +337,8 @@ int main(int argc, char* argv[]) {
     FILE* file = fopen(argv[1], "rb"); if (!file) { fprintf(debug_file, "Error: Could not open file %s: %s\n", argv[1], strerror(errno)); if (debug_file != stderr) fclose(debug_file); return 1; }
 
     KrbDocument doc = {0};
+    RenderElement** child_slots = NULL;   // All child lists, as one span per parent
+    RenderElement** root_elements = NULL;
     if (!krb_read_document(file, &doc)) { /* ... error handling ... */ goto error_cleanup; }
     fclose(file); file = NULL;
     fprintf(debug_file, "INFO: Parsed KRB OK - Elements=%u, Styles=%u, Strings=%u, Flags=0x%04X\n", doc.header.element_count, doc.header.style_count, doc.header.string_count, doc.header.flags);
@@ -345,8 +364,7 @@ int main(int argc, char* argv[]) {
         elements[i].fg_color = 0;
         elements[i].border_color = 0;
         memset(elements[i].border_widths, 0, 4);
-        elements[i].parent = NULL; elements[i].child_count = 0;
-        for(int k=0; k<MAX_ELEMENTS; ++k) elements[i].children[k] = NULL;
+        elements[i].parent = NULL; elements[i].children = NULL; elements[i].child_count = 0;
 
         elements[i].app_design_width = 0; elements[i].app_design_height = 0;
         elements[i].app_resizable = false; elements[i].app_keep_aspect = false;
@@ -395,14 +413,15 @@ int main(int argc, char* argv[]) {
                          elements[i].fg_color = color_val; // Set App's specific FG
                           fprintf(debug_file, "INFO: App Direct Prop sets FG to 0x%08X\n", elements[i].fg_color);
                      }
-                     // Read window props etc.
-                    elements[i].app_design_width = get_property_u16(app_props, app_prop_count, PROP_ID_WINDOW_WIDTH, 0);
-                    elements[i].app_design_height = get_property_u16(app_props, app_prop_count, PROP_ID_WINDOW_HEIGHT, 0);
-                    elements[i].app_resizable = get_property_bool(app_props, app_prop_count, PROP_ID_RESIZABLE, false);
-                    elements[i].app_keep_aspect = get_property_bool(app_props, app_prop_count, PROP_ID_KEEP_ASPECT, false);
-                    design_width = elements[i].app_design_width; design_height = elements[i].app_design_height;
-                    app_resizable = elements[i].app_resizable; app_keep_aspect = elements[i].app_keep_aspect;
                 }
+                // Read window props etc. (indexed lookups, once per App element)
+                const KrbPropertyIndex* app_index = &doc.property_index[i];
+                elements[i].app_design_width = get_property_u16(app_props, app_prop_count, app_index, PROP_ID_WINDOW_WIDTH, 0);
+                elements[i].app_design_height = get_property_u16(app_props, app_prop_count, app_index, PROP_ID_WINDOW_HEIGHT, 0);
+                elements[i].app_resizable = get_property_bool(app_props, app_prop_count, app_index, PROP_ID_RESIZABLE, false);
+                elements[i].app_keep_aspect = get_property_bool(app_props, app_prop_count, app_index, PROP_ID_KEEP_ASPECT, false);
+                design_width = elements[i].app_design_width; design_height = elements[i].app_design_height;
+                app_resizable = elements[i].app_resizable; app_keep_aspect = elements[i].app_keep_aspect;
             }
              fprintf(debug_file, "INFO: App Element (Final): BG=0x%08X, FG=0x%08X. Design=(%d,%d), Resizable=%d, KeepAspect=%d\n",
                      elements[i].bg_color, elements[i].fg_color, design_width, design_height, app_resizable, app_keep_aspect);
@@ -448,8 +467,8 @@ int main(int argc, char* argv[]) {
                  // Text Align
                  if (prop->property_id == PROP_ID_TEXT_ALIGNMENT && prop->value_type == 0x09 && prop->size==1 && prop->value) elements[i].text_alignment = *(uint8_t*)prop->value;
                  // Text Content
-                 if (prop->property_id == PROP_ID_TEXT_CONTENT && prop->value_type == 0x04 && prop->size==1 && prop->value) {
-                     uint8_t str_idx = *(uint8_t*)prop->value;
+                 uint16_t str_idx;
+                 if (prop->property_id == PROP_ID_TEXT_CONTENT && prop->value_type == 0x04 && krb_read_ref_value(prop->value, prop->size, &str_idx)) {
                      // KRB String table index is 0-based based on parsing log ("Strings=7" -> indices 0-6)
                      if (str_idx < doc.header.string_count && doc.strings[str_idx]) {
                          free(elements[i].text);
@@ -462,19 +481,25 @@ int main(int argc, char* argv[]) {
         }
     } // End element processing loop
 
-    // --- Build Tree (HACK) --- (Unchanged)
-    fprintf(debug_file, "WARN: Using TEMPORARY HACK for tree building...\n");
-    RenderElement* parent_stack[MAX_ELEMENTS]; int stack_top = -1;
-    for (int i = 0; i < doc.header.element_count; i++) { /* ... HACK logic ... */
-        while (stack_top >= 0) { RenderElement* p = parent_stack[stack_top]; if (p->child_count == p->header.child_count) stack_top--; else break; }
-        if (stack_top >= 0) { RenderElement* current_parent = parent_stack[stack_top]; elements[i].parent = current_parent; if (current_parent->child_count < MAX_ELEMENTS) current_parent->children[current_parent->child_count++] = &elements[i]; }
-        if (elements[i].header.child_count > 0) { if (stack_top + 1 < MAX_ELEMENTS) parent_stack[++stack_top] = &elements[i]; }
+    // --- Build Tree --- (One linear pass over the child links resolved by the reader)
+    // Each element has at most one parent, so every child list fits in one element_count array
+    child_slots = calloc(doc.header.element_count, sizeof(RenderElement*));
+    root_elements = calloc(doc.header.element_count, sizeof(RenderElement*));
+    if (!child_slots || !root_elements) { perror("calloc element tree"); goto error_cleanup; }
+    int next_slot = 0;
+    for (int i = 0; i < doc.header.element_count; i++) {
+        elements[i].children = &child_slots[next_slot];
+        for (uint16_t c = doc.element_first_child[i]; c != KRB_INVALID_INDEX && next_slot < doc.header.element_count; c = doc.element_next_sibling[c]) {
+            elements[c].parent = &elements[i];
+            elements[i].children[elements[i].child_count++] = &elements[c];
+            next_slot++;
+        }
     }
 
 
     // --- Find Roots --- (Unchanged, including App element forcing)
-    RenderElement* root_elements[MAX_ELEMENTS]; int root_count = 0;
-    for(int i = 0; i < doc.header.element_count; ++i) { if (!elements[i].parent) { if (root_count < MAX_ELEMENTS) root_elements[root_count++] = &elements[i]; else break; } }
+    int root_count = 0;
+    for(int i = 0; i < doc.header.element_count; ++i) { if (!elements[i].parent) root_elements[root_count++] = &elements[i]; }
     if (root_count == 0 && doc.header.element_count > 0) { fprintf(debug_file, "ERROR: No root elements found!\n"); goto cleanup; }
     else if (root_count > 0) { fprintf(debug_file, "INFO: Found %d root(s).\n", root_count); if (app_element && (root_count > 1 || root_elements[0] != app_element)) { root_elements[0] = app_element; root_count = 1; fprintf(debug_file, "INFO: Forcing App Element as the single root.\n"); } }
 
@@ -538,6 +563,8 @@ cleanup:
         for (int i = 0; i < doc.header.element_count; i++) free(elements[i].text);
         free(elements);
     }
+    free(child_slots);
+    free(root_elements);
     krb_free_document(&doc);
     if (debug_file && debug_file != stderr) fclose(debug_file);
     return 0;
@@ -547,6 +574,8 @@ error_cleanup:
      if(file) fclose(file);
      krb_free_document(&doc);
      if(elements) { /* Leak element text */ free(elements); }
+     free(child_slots);
+     free(root_elements);
      if (debug_file && debug_file != stderr) fclose(debug_file);
      // Attempt shutdown if tb initialized
      // tb_shutdown(); // Risky if tb_init failed